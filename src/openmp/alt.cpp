@@ -0,0 +1,414 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "graph_weighted.hpp"
+#include "sequence.hpp"
+#include "semiring.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Point-to-point shortest paths by A* with landmark lower bounds (Goldberg
+// and Harrelson, "Computing the Shortest Path: A* Search Meets Graph
+// Theory"). An offline step picks k landmarks, each as far as it gets from
+// the ones before, and keeps the exact distances from and to every one of
+// them, found by Bellman-Ford rounds on the (min, +) products. For a
+// target t, the triangle inequality gives d(L, t) - d(L, v) and
+// d(v, L) - d(t, L) as lower bounds on d(v, t), and A* led by the best of
+// them settles far fewer vertices than Dijkstra on road-like graphs. The
+// weights must not be negative.
+
+// ALT_LANDMARKS=0 leaves the bounds at zero, which is Dijkstra
+const int alt_landmarks = env_double("ALT_LANDMARKS", 8);
+// (s, t) pairs per batch
+const VertexId alt_queries = env_double("ALT_QUERIES", 64);
+// the table is loaded from ALT_TABLE, by default the graph file with .alt
+// appended, if it was made for the same number of landmarks and a graph
+// with the same size and checksum, and written there otherwise
+const char* ALT_TABLE = std::getenv("ALT_TABLE");
+
+// the frontier is pushed from while it is under this fraction of the vertices
+const int threshold_fraction_denom = 20;
+
+// distances are kept in 32 bits, with the largest value for unreachable
+const uint32_t unreachable = UINT32_MAX;
+
+// for every vertex v and landmark i, d(L_i, v) and d(v, L_i) side by side,
+// so a bound reads one row
+struct LandmarkTable {
+    int k;
+    vector<VertexId> landmarks;
+    vector<uint32_t> distances;
+
+    const uint32_t* row(VertexId v) const { return distances.data() + v * 2 * k; }
+};
+
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    # pragma omp parallel for
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        frontier_dense[frontier_sparse[i]] = true;
+    }
+}
+
+void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
+}
+
+// exact distances from root, or to root with transpose, by the rounds of
+// bellman_ford over the (min, +) products of the graph or its reverse
+template <bool transpose>
+void sssp(Graph& g, VertexId root, Weight* dist) {
+    VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
+    VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
+    bool* frontier_dense = newA(bool, g.num_nodes);
+    bool* frontier_dense_next = newA(bool, g.num_nodes);
+    bool* claimed = newA(bool, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        dist[i] = INF;
+        claimed[i] = false;
+    }
+    dist[root] = 0;
+    frontier_sparse[0] = root;
+    VertexId frontier_size = 1;
+    bool is_sparse_mode = true;
+
+    VertexId level = 0;
+    while (frontier_size != 0 && level < g.num_nodes) {
+        level++;
+        bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+        if (should_be_sparse_mode) {
+            if (!is_sparse_mode) {
+                dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+            }
+            is_sparse_mode = true;
+            frontier_size = semiring::spmspv<semiring::MinPlus<Weight>, semiring::EdgeWeights, transpose>(g, dist, frontier_sparse, frontier_size, dist, nullptr, frontier_sparse_next, claimed);
+            swap(frontier_sparse, frontier_sparse_next);
+        } else {
+            if (is_sparse_mode) {
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
+            }
+            is_sparse_mode = false;
+            frontier_size = semiring::spmv<semiring::MinPlus<Weight>, semiring::EdgeWeights, transpose>(g, dist, frontier_dense, dist, nullptr, true, frontier_dense_next);
+            swap(frontier_dense, frontier_dense_next);
+        }
+    }
+
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next); free(claimed);
+}
+
+// stores dist as the given column of the table: 2 * i for the distances
+// from landmark i, 2 * i + 1 for those to it
+void store_column(Graph& g, LandmarkTable& table, const Weight* dist, int column) {
+    bool too_far = false;
+    # pragma omp parallel for reduction(||:too_far)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (dist[v] != INF && dist[v] >= unreachable) too_far = true;
+        table.distances[v * 2 * table.k + column] = dist[v] == INF ? unreachable : dist[v];
+    }
+    if (too_far) {
+        cout << "Landmark distances do not fit in 32 bits" << endl;
+        abort();
+    }
+}
+
+// how far v is from a landmark L, given d(L, v) and d(v, L): the way there
+// and back, the one way that exists, or INF if neither does
+inline Weight round_trip(Weight from, Weight to) {
+    if (from == INF) return to;
+    if (to == INF) return from;
+    return from + to;
+}
+
+// the next landmark among the unchosen vertices with edges: one that no
+// landmark reaches or is reached from, of largest degree, if there is one,
+// and otherwise the one farthest from its closest landmark. Once only
+// vertices without edges are left, the one of smallest hash
+VertexId next_landmark(Graph& g, const Weight* closest, const vector<bool>& chosen) {
+    VertexId landmark = -1;
+    EdgeId best_degree = -1;
+    Weight farthest = -1;
+    bool uncovered = false;
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        EdgeId degree = g.out_degree(v) + g.in_degree(v);
+        if (chosen[v] || degree == 0) continue;
+        if (closest[v] == INF) {
+            if (!uncovered || degree > best_degree) {
+                landmark = v;
+                best_degree = degree;
+                uncovered = true;
+            }
+        } else if (!uncovered && closest[v] > farthest) {
+            landmark = v;
+            farthest = closest[v];
+        }
+    }
+    if (landmark >= 0) return landmark;
+
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (chosen[v]) continue;
+        if (landmark < 0 || utils::hash(v) < utils::hash(landmark)) landmark = v;
+    }
+    return landmark;
+}
+
+// picks the landmarks one after the other, each as far as it gets from the
+// ones before it in both directions, starting from the one farthest from a
+// hashed vertex, and fills in their distances
+LandmarkTable preprocess(Graph& g, int k) {
+    LandmarkTable table;
+    table.k = k;
+    table.distances.resize(g.num_nodes * 2 * k);
+    Weight* from = newA(Weight, g.num_nodes);
+    Weight* to = newA(Weight, g.num_nodes);
+    Weight* closest = newA(Weight, g.num_nodes);
+    vector<bool> chosen(g.num_nodes, false);
+
+    // the hashed vertex only seeds closest, it is not a landmark
+    VertexId seed = utils::hash(0) % g.num_nodes;
+    sssp<false>(g, seed, from);
+    sssp<true>(g, seed, to);
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        closest[v] = round_trip(from[v], to[v]);
+    }
+
+    for (int i = 0; i < k; i++) {
+        VertexId landmark = next_landmark(g, closest, chosen);
+        chosen[landmark] = true;
+        table.landmarks.push_back(landmark);
+
+        sssp<false>(g, landmark, from);
+        store_column(g, table, from, 2 * i);
+        sssp<true>(g, landmark, to);
+        store_column(g, table, to, 2 * i + 1);
+        # pragma omp parallel for
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            closest[v] = min(closest[v], round_trip(from[v], to[v]));
+        }
+        if (DEBUG) cout << "Landmark " << i << " | " << landmark << endl;
+    }
+
+    free(from); free(to); free(closest);
+    return table;
+}
+
+// splitmix64's finalizer
+inline uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// a cheap fingerprint of the out-edges: each vertex's degree, neighbors
+// and weights mixed in order, summed over the vertices
+uint64_t graph_checksum(Graph& g) {
+    uint64_t checksum = 0;
+    # pragma omp parallel for schedule(dynamic, 1024) reduction(+:checksum)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        VertexId* neighbors = g.out_neighbors(u);
+        Weight* weights = g.out_weights_neighbors(u);
+        uint64_t h = mix(u ^ ((uint64_t) g.out_degree(u) << 32));
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            h = mix(h ^ (uint64_t) neighbors[j]);
+            h = mix(h ^ (uint64_t) weights[j]);
+        }
+        checksum += h;
+    }
+    return checksum;
+}
+
+// the table in path if it was made for a graph with as many vertices and
+// edges and the same checksum, and with k landmarks
+bool load_table(const string& path, Graph& g, uint64_t checksum, int k, LandmarkTable& table) {
+    ifstream fin(path, ios::binary);
+    if (!fin) return false;
+    uint64_t header[4];
+    fin.read((char*) header, sizeof(header));
+    if (!fin || header[0] != (uint64_t) g.num_nodes || header[1] != (uint64_t) g.num_edges || header[2] != (uint64_t) k || header[3] != checksum) return false;
+    table.k = k;
+    table.landmarks.resize(k);
+    table.distances.resize(g.num_nodes * 2 * k);
+    fin.read((char*) table.landmarks.data(), k * sizeof(VertexId));
+    fin.read((char*) table.distances.data(), table.distances.size() * sizeof(uint32_t));
+    return (bool) fin;
+}
+
+void save_table(const string& path, Graph& g, uint64_t checksum, const LandmarkTable& table) {
+    ofstream fout(path, ios::binary);
+    uint64_t header[4] = {(uint64_t) g.num_nodes, (uint64_t) g.num_edges, (uint64_t) table.k, checksum};
+    fout.write((const char*) header, sizeof(header));
+    fout.write((const char*) table.landmarks.data(), table.k * sizeof(VertexId));
+    fout.write((const char*) table.distances.data(), table.distances.size() * sizeof(uint32_t));
+}
+
+// a lower bound on d(v, t) by the triangle inequality over every landmark
+inline Weight landmark_bound(const LandmarkTable& table, VertexId v, VertexId t) {
+    const uint32_t* dv = table.row(v);
+    const uint32_t* dt = table.row(t);
+    Weight bound = 0;
+    for (int i = 0; i < 2 * table.k; i += 2) {
+        // d(L, t) <= d(L, v) + d(v, t)
+        if (dv[i] != unreachable && dt[i] != unreachable) bound = max(bound, (Weight) dt[i] - (Weight) dv[i]);
+        // d(v, L) <= d(v, t) + d(t, L)
+        if (dv[i + 1] != unreachable && dt[i + 1] != unreachable) bound = max(bound, (Weight) dv[i + 1] - (Weight) dt[i + 1]);
+    }
+    return bound;
+}
+
+// per-thread state of a query: dist[v] is valid while stamp[v] is the
+// current query's, and v is settled while done[v] is
+struct AStarState {
+    vector<uint32_t> stamp;
+    vector<uint32_t> done;
+    vector<Weight> dist;
+    vector<pair<Weight, VertexId>> heap;
+    uint32_t query;
+    VertexId settled;
+
+    AStarState(VertexId n) : stamp(n, 0), done(n, 0), dist(n), query(0), settled(0) {}
+
+    // a fresh timestamp; the marks are only cleared when they wrap around
+    uint32_t next_query() {
+        if (++query == 0) {
+            fill(stamp.begin(), stamp.end(), 0);
+            fill(done.begin(), done.end(), 0);
+            query = 1;
+        }
+        return query;
+    }
+};
+
+// the length of a shortest path from s to t, or INF if there is none. The
+// bounds are consistent, so a settled vertex is never improved on
+Weight astar(Graph& g, const LandmarkTable& table, VertexId s, VertexId t, AStarState& state) {
+    uint32_t query = state.next_query();
+    vector<pair<Weight, VertexId>>& heap = state.heap;
+    greater<pair<Weight, VertexId>> later;
+    heap.clear();
+    state.settled = 0;
+
+    state.stamp[s] = query;
+    state.dist[s] = 0;
+    heap.push_back(make_pair(landmark_bound(table, s, t), s));
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        VertexId u = heap.back().second;
+        heap.pop_back();
+        if (state.done[u] == query) continue;
+        state.done[u] = query;
+        state.settled++;
+        if (u == t) return state.dist[u];
+
+        VertexId* neighbors = g.out_neighbors(u);
+        Weight* weights = g.out_weights_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            if (state.done[v] == query) continue;
+            Weight d = state.dist[u] + weights[j];
+            if (state.stamp[v] == query && state.dist[v] <= d) continue;
+            state.stamp[v] = query;
+            state.dist[v] = d;
+            heap.push_back(make_pair(d + landmark_bound(table, v, t), v));
+            push_heap(heap.begin(), heap.end(), later);
+        }
+    }
+    return INF;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./alt <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    bool has_negative = false;
+    # pragma omp parallel for reduction(||:has_negative)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        Weight* weights = g.out_weights_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            if (weights[j] < 0) has_negative = true;
+        }
+    }
+    if (has_negative) {
+        cout << "A* needs non-negative edge weights" << endl;
+        abort();
+    }
+
+    int k = min((VertexId) alt_landmarks, g.num_nodes);
+    string table_path = ALT_TABLE != nullptr ? string(ALT_TABLE) : string(argv[1]) + ".alt";
+    LandmarkTable table;
+    table.k = 0;
+    uint64_t checksum = k > 0 ? graph_checksum(g) : 0;
+    if (k > 0 && !load_table(table_path, g, checksum, k, table)) {
+        auto time_before = chrono::system_clock::now();
+        table = preprocess(g, k);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        cout << "preprocessing_time: " << delta_time.count() << endl;
+        save_table(table_path, g, checksum, table);
+    }
+
+    srand(time(NULL));
+    vector<AStarState*> states(omp_get_max_threads());
+    for (size_t i = 0; i < states.size(); i++) {
+        states[i] = new AStarState(g.num_nodes);
+    }
+
+    vector<pair<VertexId, VertexId>> pairs(alt_queries);
+    VertexId reachable = 0;
+    double distance_sum = 0, settled = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        for (VertexId q = 0; q < alt_queries; q++) {
+            pairs[q] = make_pair(rand() % g.num_nodes, rand() % g.num_nodes);
+        }
+        auto time_before = chrono::system_clock::now();
+        # pragma omp parallel for schedule(dynamic, 1) reduction(+ : reachable, distance_sum, settled)
+        for (VertexId q = 0; q < alt_queries; q++) {
+            AStarState& state = *states[omp_get_thread_num()];
+            Weight d = astar(g, table, pairs[q].first, pairs[q].second, state);
+            if (d != INF) {
+                reachable++;
+                distance_sum += d;
+            }
+            settled += state.settled;
+        }
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+    }
+
+    for (AStarState* state : states) {
+        delete state;
+    }
+
+    cout << "queries: " << alt_queries << endl;
+    cout << "landmarks: " << table.k << endl;
+    cout << "reachable: " << (double) reachable / num_iters << endl;
+    cout << "mean_distance: " << (reachable > 0 ? distance_sum / reachable : 0) << endl;
+    cout << "settled_per_query: " << settled / alt_queries / num_iters << endl;
+    cout << "queries_per_second: " << alt_queries * num_iters / current_time << endl;
+    cout << current_time / num_iters << endl;
+}
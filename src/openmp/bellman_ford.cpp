@@ -17,6 +17,7 @@ using namespace std;
 
 #include "graph.hpp"
 #include "sequence.hpp"
+#include "semiring.hpp"
 #include "utils.hpp"
 
 using namespace std;
@@ -30,63 +31,27 @@ void print_vector(const vector<T> & v) {
     cout << endl;
 }
 
-struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+// BF_MODE=async relaxes by in-place sweeps over every vertex
+const char* BF_MODE = std::getenv("BF_MODE");
 
-VertexId bf_sparse(Graph& g, Weight* dist, Weight* dist_next, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId level) {
-    // update dist_next to take dist's values
-    # pragma omp parallel for
-    for (VertexId i = 0; i < g.num_nodes; i++) {
-        dist_next[i] = dist[i];
-        frontier_next[i] = -1;
-    }
-
-    # pragma omp parallel for
-    for (VertexId i = 0; i < frontier_size; i++) {
-        VertexId u = frontier[i];
-        VertexId* neighbors = g.out_neighbors(u);
-        Weight* weights = g.out_weights_neighbors(u);
-        for (EdgeId j = 0; j < g.out_degree(u); j++) {
-            VertexId v = neighbors[j];
-            Weight relax_dist = dist[u] + weights[j];
-            if (priority_update(&dist_next[v], relax_dist)) {
-                frontier_next[v] = v;
-            }
-        }
-    }
+// a round relaxes the out-edges of the frontier over (min, +), pushing
+// from a sparse frontier and pulling into every vertex from a dense one.
+// dist is both the input and the output vector, lowered in place
+VertexId bf_sparse(Graph& g, Weight* dist, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, bool* claimed) {
+    return semiring::spmspv<semiring::MinPlus<Weight>, semiring::EdgeWeights>(g, dist, frontier, frontier_size, dist, nullptr, frontier_next, claimed);
+}
 
-    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
-    return frontier_size;
+VertexId bf_dense(Graph& g, Weight* dist, bool* frontier, bool* frontier_next) {
+    return semiring::spmv<semiring::MinPlus<Weight>, semiring::EdgeWeights>(g, dist, frontier, dist, nullptr, true, frontier_next);
 }
 
-VertexId bf_dense(Graph& g, Weight* dist, Weight* dist_next, bool* frontier, bool* frontier_next, VertexId level) {
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
     # pragma omp parallel for
-    for (VertexId u = 0; u < g.num_nodes; u++) {
-        // update next round of dist
-        dist_next[u] = dist[u];
-        frontier_next[u] = false;
-
-        VertexId* neighbors = g.in_neighbors(u);
-        Weight* weights = g.in_weights_neighbors(u); 
-
-        for (EdgeId j = 0; j < g.in_degree(u); j++) {
-            VertexId v = neighbors[j];
-
-            // ignore neighbors not in frontier
-            if (!frontier[v]) continue;
-            
-            Weight relax_dist = dist[v]+weights[j];
-            if (relax_dist < dist_next[u]) {
-                dist_next[u] = relax_dist;
-                compare_and_compare_and_swap(&frontier_next[u]);
-            }
-        }
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
     }
 
-    VertexId frontier_size = sequence::sumFlagsSerial(frontier_next, g.num_nodes);
-    return frontier_size;
-}
-
-void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
     # pragma omp parallel for
     for (VertexId i = 0; i < frontier_size; i++) {
         frontier_dense[frontier_sparse[i]] = true;
@@ -94,29 +59,24 @@ void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* fr
 }
 
 void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
-    # pragma omp parallel for
-    for (VertexId i = 0; i < num_nodes; i++) {
-        if (frontier_dense[i]) {
-            frontier_sparse[i] = i;
-        } else {
-            frontier_sparse[i] = -1;
-        }
-    }
-    sequence::filter(frontier_sparse, frontier_sparse, num_nodes, nonNegF());
+    // pack straight from the flags; filtering frontier_sparse onto itself
+    // races between blocks in the parallel pack
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
 }
 
 Weight* bellman_ford(Graph& g, VertexId root) {
     Weight* dist = newA(Weight, g.num_nodes);
-    Weight* dist_next = newA(Weight, g.num_nodes);
 
     VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
     VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
     bool* frontier_dense = newA(bool, g.num_nodes);
     bool* frontier_dense_next = newA(bool, g.num_nodes);
+    bool* claimed = newA(bool, g.num_nodes);
     
     # pragma omp parallel for
     for (VertexId i = 0; i < g.num_nodes; i++) {
         dist[i] = INF;
+        claimed[i] = false;
     }
 
     bool is_sparse_mode = true;
@@ -139,26 +99,63 @@ Weight* bellman_ford(Graph& g, VertexId root) {
                 dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
             }
             is_sparse_mode = true;
-            frontier_size = bf_sparse(g, dist, dist_next, frontier_sparse, frontier_sparse_next, frontier_size, level);
+            frontier_size = bf_sparse(g, dist, frontier_sparse, frontier_sparse_next, frontier_size, claimed);
+            swap(frontier_sparse, frontier_sparse_next);
         } else {
             if (is_sparse_mode) {
-                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
             }
             is_sparse_mode = false;
-            frontier_size = bf_dense(g, dist, dist_next, frontier_dense, frontier_dense_next, level);
+            frontier_size = bf_dense(g, dist, frontier_dense, frontier_dense_next);
+            swap(frontier_dense, frontier_dense_next);
         }
-        swap(dist, dist_next);
 
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
         if (DEBUG) cout << "Time: " << delta.count() << endl;
     }
 
-    free(dist_next); free(frontier_dense); free(frontier_dense_next); free(frontier_sparse); free(frontier_sparse_next);
+    free(frontier_dense); free(frontier_dense_next); free(frontier_sparse); free(frontier_sparse_next); free(claimed);
     
     return dist;
 }
 
+// Asynchronous (Gauss-Seidel) Bellman-Ford: every sweep pulls each
+// distance down over its in-edges in place, so an improved distance already
+// relaxes the vertices after it within the same sweep. Only u's iteration
+// writes dist[u], but others read it meanwhile, hence the relaxed atomics.
+// Done once a sweep improves nothing, or after n sweeps
+Weight* bellman_ford_async(Graph& g, VertexId root) {
+    Weight* dist = newA(Weight, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        dist[i] = INF;
+    }
+    dist[root] = 0;
+
+    VertexId num_changed = 1;
+    VertexId sweep = 0;
+    while (num_changed != 0 && sweep < g.num_nodes) {
+        sweep++;
+        num_changed = 0;
+        # pragma omp parallel for schedule(dynamic, 1024) reduction(+ : num_changed)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            Weight best = dist[u];
+            VertexId* neighbors = g.in_neighbors(u);
+            Weight* weights = g.in_weights_neighbors(u);
+            for (EdgeId j = 0; j < g.in_degree(u); j++) {
+                Weight d = relaxed_load(&dist[neighbors[j]]);
+                if (d != INF && d + weights[j] < best) best = d + weights[j];
+            }
+            if (best < dist[u]) {
+                relaxed_store(&dist[u], best);
+                num_changed++;
+            }
+        }
+        if (DEBUG) cout << "Sweep " << sweep << " | " << "Changed: " << num_changed << endl;
+    }
+    return dist;
+}
 
 bool compare(Weight v1, Weight w, Weight v2) {
     // checks if v1 + w < v2
@@ -223,11 +220,12 @@ int main(int argc, char *argv[]) {
     
     Graph g(argv[1]);
     float current_time = 0.0;
+    bool use_async = BF_MODE != nullptr && strcmp(BF_MODE, "async") == 0;
     srand(time(NULL));
     for (int i = 0; i < num_iters; i++) {
         VertexId root = rand() % g.num_nodes;
         auto time_before = chrono::system_clock::now();
-        Weight* dists = bellman_ford(g, root);
+        Weight* dists = use_async ? bellman_ford_async(g, root) : bellman_ford(g, root);
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta_time = time_after - time_before;
         current_time += delta_time.count();
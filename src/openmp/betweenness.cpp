@@ -0,0 +1,267 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+
+#include "graph.hpp"
+#include "frontier.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Betweenness centrality (Brandes, "A Faster Algorithm for Betweenness
+// Centrality"). A batch of sources is searched at once: every vertex keeps
+// a depth, a shortest path count sigma and a dependency delta per source,
+// laid out vertex-major so a single edge scan serves the whole batch. The
+// forward phase is a level-synchronous BFS recording each level's frontier,
+// the backward phase walks those frontiers in reverse and pulls the
+// dependencies of the successors.
+
+typedef int Level;
+
+struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+
+// BC_SOURCES=k samples k random sources and scales the result by n / k;
+// unset or 0 computes the exact centrality from every vertex
+const VertexId bc_num_sources = env_double("BC_SOURCES", 0);
+// sources searched together
+const int bc_batch = env_double("BC_BATCH", 16);
+
+// top-down: the frontier pushes depth d + 1 to its out-neighbors
+void bc_sparse(Graph& g, int batch, Level* depth, const vector<VertexId>& frontier, VertexId* frontier_next, Level d) {
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (size_t i = 0; i < frontier.size(); i++) {
+        VertexId u = frontier[i];
+        const Level* u_depth = depth + u * batch;
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            Level* v_depth = depth + v * batch;
+            bool reached = false;
+            for (int s = 0; s < batch; s++) {
+                // racing writers all store the same level
+                if (u_depth[s] == d && v_depth[s] < 0) {
+                    v_depth[s] = d + 1;
+                    reached = true;
+                }
+            }
+            if (reached) frontier_next[v] = v;
+        }
+    }
+}
+
+// bottom-up: every vertex some source has not reached yet looks for
+// in-neighbors at depth d
+void bc_dense(Graph& g, int batch, Level* depth, VertexId* frontier_next, Level d) {
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        Level* v_depth = depth + v * batch;
+        int unreached = 0;
+        for (int s = 0; s < batch; s++) {
+            if (v_depth[s] < 0) unreached++;
+        }
+        if (unreached == 0) continue;
+
+        bool reached = false;
+        VertexId* neighbors = g.in_neighbors(v);
+        for (EdgeId j = 0; j < g.in_degree(v) && unreached > 0; j++) {
+            const Level* u_depth = depth + neighbors[j] * batch;
+            for (int s = 0; s < batch; s++) {
+                if (u_depth[s] == d && v_depth[s] < 0) {
+                    v_depth[s] = d + 1;
+                    unreached--;
+                    reached = true;
+                }
+            }
+        }
+        if (reached) frontier_next[v] = v;
+    }
+}
+
+// sigma of the new frontier, pulled from its predecessors at depth d
+void count_paths(Graph& g, int batch, const Level* depth, double* sigma, const vector<VertexId>& frontier, Level d) {
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (size_t i = 0; i < frontier.size(); i++) {
+        VertexId v = frontier[i];
+        const Level* v_depth = depth + v * batch;
+        double* v_sigma = sigma + v * batch;
+        VertexId* neighbors = g.in_neighbors(v);
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            VertexId u = neighbors[j];
+            const Level* u_depth = depth + u * batch;
+            const double* u_sigma = sigma + u * batch;
+            for (int s = 0; s < batch; s++) {
+                if (v_depth[s] == d + 1 && u_depth[s] == d) v_sigma[s] += u_sigma[s];
+            }
+        }
+    }
+}
+
+// the out-edges of frontier go into frontier_edges; returns those of the
+// vertices in it that every source has reached by now
+EdgeId finished_edges(Graph& g, int batch, const Level* depth, const vector<VertexId>& frontier, EdgeId& frontier_edges) {
+    EdgeId edges = 0, finished = 0;
+    # pragma omp parallel for reduction(+ : edges, finished)
+    for (size_t i = 0; i < frontier.size(); i++) {
+        VertexId v = frontier[i];
+        edges += g.out_degree(v);
+        const Level* v_depth = depth + v * batch;
+        bool done = true;
+        for (int s = 0; s < batch && done; s++) {
+            if (v_depth[s] < 0) done = false;
+        }
+        if (done) finished += g.out_degree(v);
+    }
+    frontier_edges = edges;
+    return finished;
+}
+
+// runs Brandes from the batch of sources and adds their dependencies to bc
+void bc_batch_sources(Graph& g, const VertexId* sources, int batch, Level* depth, double* sigma, double* delta, VertexId* frontier_next, double* bc) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes * batch; i++) {
+        depth[i] = -1;
+        sigma[i] = 0;
+        delta[i] = 0;
+    }
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_next[i] = -1;
+    }
+
+    // levels[d] holds every vertex that is at depth d from some source
+    vector<vector<VertexId>> levels(1);
+    for (int s = 0; s < batch; s++) {
+        depth[sources[s] * batch + s] = 0;
+        sigma[sources[s] * batch + s] = 1;
+        if (frontier_next[sources[s]] < 0) {
+            frontier_next[sources[s]] = sources[s];
+            levels[0].push_back(sources[s]);
+        }
+    }
+    // the direction switch of bfs, with the unexplored edges being those
+    // of vertices that some source has not reached yet, as in ms_bfs
+    EdgeId frontier_edges = 0;
+    EdgeId unexplored_edges = g.num_edges - finished_edges(g, batch, depth, levels[0], frontier_edges);
+    for (VertexId u : levels[0]) frontier_next[u] = -1;
+    bool is_sparse_mode = true;
+    VertexId prev_frontier_size = 0;
+
+    // forward phase
+    for (Level d = 0; !levels[d].empty(); d++) {
+        is_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, levels[d].size(), prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = levels[d].size();
+        if (is_sparse_mode) {
+            bc_sparse(g, batch, depth, levels[d], frontier_next, d);
+        } else {
+            bc_dense(g, batch, depth, frontier_next, d);
+        }
+        vector<VertexId> frontier(g.num_nodes);
+        VertexId frontier_size = sequence::filter(frontier_next, frontier.data(), g.num_nodes, nonNegF());
+        frontier.resize(frontier_size);
+        # pragma omp parallel for
+        for (VertexId i = 0; i < frontier_size; i++) {
+            frontier_next[frontier[i]] = -1;
+        }
+        unexplored_edges -= finished_edges(g, batch, depth, frontier, frontier_edges);
+        count_paths(g, batch, depth, sigma, frontier, d);
+        levels.push_back(move(frontier));
+        if (DEBUG) cout << "Level " << d + 1 << " | " << "Frontier: " << frontier_size << endl;
+    }
+
+    // backward phase: a vertex at depth d pulls the dependencies of its
+    // successors at depth d + 1, which are final by then. Each vertex is
+    // listed at most once per level, so it is only ever written by one thread
+    for (Level d = (Level) levels.size() - 2; d >= 0; d--) {
+        # pragma omp parallel for schedule(dynamic, 64)
+        for (size_t i = 0; i < levels[d].size(); i++) {
+            VertexId u = levels[d][i];
+            const Level* u_depth = depth + u * batch;
+            const double* u_sigma = sigma + u * batch;
+            double* u_delta = delta + u * batch;
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                VertexId v = neighbors[j];
+                const Level* v_depth = depth + v * batch;
+                const double* v_sigma = sigma + v * batch;
+                const double* v_delta = delta + v * batch;
+                for (int s = 0; s < batch; s++) {
+                    if (u_depth[s] == d && v_depth[s] == d + 1) {
+                        u_delta[s] += u_sigma[s] / v_sigma[s] * (1 + v_delta[s]);
+                    }
+                }
+            }
+            for (int s = 0; s < batch; s++) {
+                if (u_depth[s] == d && u != sources[s]) bc[u] += u_delta[s];
+            }
+        }
+    }
+}
+
+// centrality from the given sources, scaled by scale
+double* betweenness(Graph& g, const vector<VertexId>& sources, double scale) {
+    int batch = max(1, min(bc_batch, (int) sources.size()));
+    double* bc = newA(double, g.num_nodes);
+    Level* depth = newA(Level, g.num_nodes * batch);
+    double* sigma = newA(double, g.num_nodes * batch);
+    double* delta = newA(double, g.num_nodes * batch);
+    VertexId* frontier_next = newA(VertexId, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        bc[i] = 0;
+    }
+
+    for (size_t i = 0; i < sources.size(); i += batch) {
+        // the last batch may be short
+        int size = min((size_t) batch, sources.size() - i);
+        bc_batch_sources(g, sources.data() + i, size, depth, sigma, delta, frontier_next, bc);
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        bc[i] *= scale;
+    }
+    free(depth); free(sigma); free(delta); free(frontier_next);
+    return bc;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./betweenness <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    srand(time(NULL));
+    bool exact = bc_num_sources <= 0;
+    vector<VertexId> sources(exact ? g.num_nodes : bc_num_sources);
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        for (VertexId s = 0; s < (VertexId) sources.size(); s++) {
+            sources[s] = exact ? s : rand() % g.num_nodes;
+        }
+        auto time_before = chrono::system_clock::now();
+        double* bc = betweenness(g, sources, exact ? 1.0 : (double) g.num_nodes / sources.size());
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        if (DEBUG) {
+            VertexId top = max_element(bc, bc + g.num_nodes) - bc;
+            cout << "Most central vertex " << top << " | " << bc[top] << endl;
+        }
+        free(bc);
+    }
+
+    cout << "sources: " << sources.size() << endl;
+    cout << current_time / num_iters << endl;
+}
@@ -7,9 +7,14 @@
 #include <vector>
 #include <queue>
 #include <climits>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
 
 #include "graph.hpp"
+#include "frontier.hpp"
 #include "sequence.hpp"
+#include "semiring.hpp"
 #include "utils.hpp"
 
 using namespace std;
@@ -26,87 +31,85 @@ void print_vector(const vector<T> & v) {
 
 struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
 
-VertexId bfs_sparse(Graph& g, Distance* dist, Distance* dist_next, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId level) { 
-    // update dist_next to take dist's values
-    # pragma omp parallel for
-    for (VertexId i = 0; i < g.num_nodes; i++) {
-        dist_next[i] = dist[i];
-        frontier_next[i] = -1;
-    } 
+// BFS_MODE=graph500 runs the Graph500 benchmark instead of timing random roots
+const char* BFS_MODE = std::getenv("BFS_MODE");
+const int graph500_num_roots = 64;
 
-    # pragma omp parallel for
+// multi-source BFS (Then et al., "The More the Merrier: Efficient
+// Multi-Source Graph Traversal"): every vertex keeps one bit per source in
+// seen/visit/visit_next, so a single edge scan advances all searches of a
+// batch. BFS_MODE=multisource times batches of BFS_BATCH random roots.
+typedef uint64_t SourceMask;
+const int mask_bits = 64;
+const int ms_bfs_max_sources = 512;
+const int ms_bfs_batch = env_double("BFS_BATCH", 64);
+
+// a round reaches the out-neighbors of the frontier over (or, and), with
+// visited as the accumulated output: pushing from a sparse frontier, whose
+// entries of visited are all set, and pulling into the unvisited vertices
+// from a dense one, which stops at the first frontier in-neighbor. The
+// vertices reached first get distance level, and their out-edges go into
+// frontier_edges
+VertexId bfs_sparse(Graph& g, Distance* dist, bool* visited, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId level, EdgeId& frontier_edges, bool* claimed) {
+    frontier_size = semiring::spmspv<semiring::OrAnd>(g, visited, frontier, frontier_size, visited, nullptr, frontier_next, claimed);
+
+    EdgeId edges = 0;
+    # pragma omp parallel for reduction(+ : edges)
     for (VertexId i = 0; i < frontier_size; i++) {
-        
-        VertexId u = frontier[i];
-        VertexId* neighbors = g.out_neighbors(u);
-        for (EdgeId j = 0; j < g.out_degree(u); j++) {
-            VertexId v = neighbors[j];
-            if (compare_and_swap(&dist_next[v], INF, level)) {
-                frontier_next[v] = v;
-            }
-        }
+        dist[frontier_next[i]] = level;
+        edges += g.out_degree(frontier_next[i]);
     }
-
-    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+    frontier_edges = edges;
     return frontier_size;
 }
 
-VertexId bfs_dense(Graph& g, Distance* dist, Distance* dist_next, bool* frontier, bool* frontier_next, VertexId level) {
-    # pragma omp parallel for
-    for (VertexId u = 0; u < g.num_nodes; u++) {
-        // update next round of dist
-        dist_next[u] = dist[u];
-        frontier_next[u] = false;
-        // ignore if distance is set already
-        if (dist_next[u] != INF) continue;
-        VertexId* neighbors = g.in_neighbors(u);
-        for (EdgeId j = 0; j < g.in_degree(u); j++) {
-            VertexId v = neighbors[j];
+VertexId bfs_dense(Graph& g, Distance* dist, bool* visited, bool* frontier, bool* frontier_next, VertexId level, EdgeId& frontier_edges) {
+    VertexId frontier_size = semiring::spmv<semiring::OrAnd>(g, frontier, nullptr, visited, nullptr, true, frontier_next);
 
-            if (!frontier[v]) continue;
-            
-            dist_next[u] = level;
-            frontier_next[u] = true;
-        }
+    EdgeId edges = 0;
+    # pragma omp parallel for reduction(+ : edges)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        if (!frontier_next[u]) continue;
+        dist[u] = level;
+        edges += g.out_degree(u);
     }
-
-    
-    VertexId frontier_size = sequence::sumFlagsSerial(frontier_next, g.num_nodes);
-    
+    frontier_edges = edges;
     return frontier_size;
 }
 
-void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
-    # pragma omp parallel for
-    for (VertexId i = 0; i < frontier_size; i++) {
-        frontier_dense[frontier_sparse[i]] = true;
-    }
-}
-
-void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
-    # pragma omp parallel for
-    for (VertexId i = 0; i < num_nodes; i++) {
-        if (frontier_dense[i]) {
-            frontier_sparse[i] = i;
-        } else {
-            frontier_sparse[i] = -1;
+// a BFS tree from the distances: every reached vertex but the root takes
+// an in-neighbor one level closer to the root as its parent
+void bfs_parents(Graph& g, VertexId root, const Distance* dist, VertexId* parent) {
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        parent[u] = u == root ? root : -1;
+        if (u == root || dist[u] == INF) continue;
+        VertexId* neighbors = g.in_neighbors(u);
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            if (dist[neighbors[j]] == dist[u] - 1) {
+                parent[u] = neighbors[j];
+                break;
+            }
         }
     }
-    sequence::filter(frontier_sparse, frontier_sparse, num_nodes, nonNegF());
 }
 
-Distance* bfs(Graph& g, VertexId root) {
+// parent is optional and only filled in when non-null
+Distance* bfs(Graph& g, VertexId root, VertexId* parent = nullptr) {
     Distance* dist = newA(Distance, g.num_nodes);
-    Distance* dist_next = newA(Distance, g.num_nodes);
 
     VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
     VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
     bool* frontier_dense = newA(bool, g.num_nodes);
     bool* frontier_dense_next = newA(bool, g.num_nodes);
+    bool* visited = newA(bool, g.num_nodes);
+    bool* claimed = newA(bool, g.num_nodes);
 
     # pragma omp parallel for
     for (VertexId i = 0; i < g.num_nodes; i++) {
         dist[i] = INF; // set INF
+        visited[i] = false;
+        claimed[i] = false;
     }
 
     bool is_sparse_mode = true;
@@ -114,13 +117,20 @@ Distance* bfs(Graph& g, VertexId root) {
     frontier_sparse[0] = root;
     VertexId frontier_size = 1;
     dist[root] = 0;
+    visited[root] = true;
+
+    // m_f and m_u in Beamer et al.: out-edges of the frontier, and
+    // out-edges of vertices that have not been reached yet
+    EdgeId frontier_edges = g.out_degree(root);
+    EdgeId unexplored_edges = g.num_edges - frontier_edges;
+    VertexId prev_frontier_size = 0;
 
     VertexId level = 0;
-    const int threshold_fraction_denom = 20; 
 
     while (frontier_size != 0) {
         level++; 
-        bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+        bool should_be_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
 
         if (DEBUG) cout << "Round " << level << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
         auto time_before = chrono::system_clock::now();
@@ -130,25 +140,369 @@ Distance* bfs(Graph& g, VertexId root) {
                 dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
             }
             is_sparse_mode = true;
-            frontier_size = bfs_sparse(g, dist, dist_next, frontier_sparse, frontier_sparse_next, frontier_size, level);
+            frontier_size = bfs_sparse(g, dist, visited, frontier_sparse, frontier_sparse_next, frontier_size, level, frontier_edges, claimed);
+            swap(frontier_sparse, frontier_sparse_next);
         } else {
             if (is_sparse_mode) {
-                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
             }
             is_sparse_mode = false;
-            frontier_size = bfs_dense(g, dist, dist_next, frontier_dense, frontier_dense_next, level);
+            frontier_size = bfs_dense(g, dist, visited, frontier_dense, frontier_dense_next, level, frontier_edges);
             swap(frontier_dense, frontier_dense_next);
         }
-        swap(dist_next, dist); 
+        unexplored_edges -= frontier_edges;
 
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
         if (DEBUG) cout << "Time: " << delta.count() << endl;
     }
-    free(dist_next); free(frontier_dense); free(frontier_dense_next); free(frontier_sparse); free(frontier_sparse_next);
+    free(frontier_dense); free(frontier_dense_next); free(frontier_sparse); free(frontier_sparse_next); free(visited); free(claimed);
+    if (parent != nullptr) bfs_parents(g, root, dist, parent);
+    return dist;
+}
+
+// marks the sources in next as having seen v and records their distance to
+// v; returns v's out-degree once all sources have seen v, so the caller can
+// retire its edges from the unexplored count
+EdgeId ms_bfs_visit(Graph& g, int words, VertexId v, SourceMask* seen, const SourceMask* next, Distance* dist, VertexId level) {
+    bool finished = true;
+    for (int w = 0; w < words; w++) {
+        SourceMask bits = next[w];
+        seen[v*words + w] |= bits;
+        if (~seen[v*words + w] != 0) finished = false;
+        while (bits != 0) {
+            int s = w * mask_bits + __builtin_ctzll(bits);
+            dist[(EdgeId) s * g.num_nodes + v] = level;
+            bits &= bits - 1;
+        }
+    }
+    return finished ? g.out_degree(v) : 0;
+}
+
+// visit_next must be all zero on entry; visit is cleared for the frontier
+// on the way out so the two can be swapped
+VertexId ms_bfs_sparse(Graph& g, int words, Distance* dist, SourceMask* seen, SourceMask* visit, SourceMask* visit_next, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId level, EdgeId& frontier_edges, EdgeId& finished_edges) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_next[i] = -1;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            bool reached = false;
+            for (int w = 0; w < words; w++) {
+                SourceMask next = visit[u*words + w] & ~seen[v*words + w];
+                if (next == 0) continue;
+                reached = true;
+                // skip the atomic if another frontier vertex got there first
+                if ((visit_next[v*words + w] & next) != next) __sync_fetch_and_or(&visit_next[v*words + w], next);
+            }
+            if (reached) frontier_next[v] = v;
+        }
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        for (int w = 0; w < words; w++) visit[u*words + w] = 0;
+    }
+
+    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+
+    EdgeId edges = 0, finished = 0;
+    # pragma omp parallel for reduction(+ : edges, finished)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId v = frontier[i];
+        edges += g.out_degree(v);
+        finished += ms_bfs_visit(g, words, v, seen, visit_next + v*words, dist, level);
+    }
+    frontier_edges = edges;
+    finished_edges = finished;
+    return frontier_size;
+}
+
+// frontier_next flags the vertices with any visit_next bit set, for
+// converting back to a sparse frontier
+VertexId ms_bfs_dense(Graph& g, int words, Distance* dist, SourceMask* seen, SourceMask* visit, SourceMask* visit_next, bool* frontier_next, VertexId level, EdgeId& frontier_edges, EdgeId& finished_edges) {
+    EdgeId edges = 0, finished = 0;
+    VertexId frontier_size = 0;
+    # pragma omp parallel for reduction(+ : edges, finished, frontier_size)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        SourceMask* next = visit_next + v*words;
+        SourceMask* v_seen = seen + v*words;
+        bool active = false;
+        for (int w = 0; w < words; w++) {
+            next[w] = 0;
+            if (~v_seen[w] != 0) active = true;
+        }
+        frontier_next[v] = false;
+        // ignore if every source has seen v already
+        if (!active) continue;
+
+        VertexId* neighbors = g.in_neighbors(v);
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            VertexId u = neighbors[j];
+            bool done = true;
+            for (int w = 0; w < words; w++) {
+                next[w] |= visit[u*words + w] & ~v_seen[w];
+                if (next[w] != ~v_seen[w]) done = false;
+            }
+            // every source missing v reaches it this round, skip the rest
+            if (done) break;
+        }
+
+        active = false;
+        for (int w = 0; w < words; w++) {
+            if (next[w] != 0) active = true;
+        }
+        if (!active) continue;
+        frontier_next[v] = true;
+        frontier_size++;
+        edges += g.out_degree(v);
+        finished += ms_bfs_visit(g, words, v, seen, next, dist, level);
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < (EdgeId) g.num_nodes * words; i++) {
+        visit[i] = 0;
+    }
+    frontier_edges = edges;
+    finished_edges = finished;
+    return frontier_size;
+}
+
+// runs a BFS from each of up to ms_bfs_max_sources sources at once; the
+// distance from sources[s] to v is returned at s * g.num_nodes + v
+Distance* ms_bfs(Graph& g, const VertexId* sources, int num_sources) {
+    int words = (num_sources + mask_bits - 1) / mask_bits;
+    Distance* dist = newA(Distance, (EdgeId) num_sources * g.num_nodes);
+    SourceMask* seen = newA(SourceMask, (EdgeId) g.num_nodes * words);
+    SourceMask* visit = newA(SourceMask, (EdgeId) g.num_nodes * words);
+    SourceMask* visit_next = newA(SourceMask, (EdgeId) g.num_nodes * words);
+
+    VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
+    VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
+    bool* frontier_dense = newA(bool, g.num_nodes);
+
+    # pragma omp parallel for
+    for (EdgeId i = 0; i < (EdgeId) num_sources * g.num_nodes; i++) {
+        dist[i] = INF;
+    }
+    // bits past num_sources start out seen, so a vertex is finished
+    // exactly when all of its seen bits are set
+    SourceMask unused = num_sources % mask_bits == 0 ? 0 : ~(SourceMask) 0 << (num_sources % mask_bits);
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        for (int w = 0; w < words; w++) {
+            seen[v*words + w] = w == words - 1 ? unused : 0;
+            visit[v*words + w] = 0;
+            visit_next[v*words + w] = 0;
+        }
+    }
+
+    VertexId frontier_size = 0;
+    for (int s = 0; s < num_sources; s++) {
+        VertexId root = sources[s];
+        bool is_new = true;
+        for (int w = 0; w < words; w++) {
+            if (visit[root*words + w] != 0) is_new = false;
+        }
+        if (is_new) frontier_sparse[frontier_size++] = root;
+        visit[root*words + s / mask_bits] |= (SourceMask) 1 << (s % mask_bits);
+    }
+
+    bool is_sparse_mode = true;
+
+    // same direction-optimizing switch as bfs(), with the unexplored edges
+    // being those of vertices that some source has not seen yet
+    EdgeId frontier_edges = 0;
+    EdgeId unexplored_edges = g.num_edges;
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId root = frontier_sparse[i];
+        frontier_edges += g.out_degree(root);
+        unexplored_edges -= ms_bfs_visit(g, words, root, seen, visit + root*words, dist, 0);
+    }
+    VertexId prev_frontier_size = 0;
+
+    VertexId level = 0;
+
+    while (frontier_size != 0) {
+        level++;
+        bool should_be_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
+
+        if (DEBUG) cout << "Round " << level << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+        EdgeId finished_edges;
+        // the dense kernel reads visit directly, so only the way back to
+        // a sparse frontier needs a conversion
+        if (should_be_sparse_mode) {
+            if (!is_sparse_mode) {
+                dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+            }
+            is_sparse_mode = true;
+            frontier_size = ms_bfs_sparse(g, words, dist, seen, visit, visit_next, frontier_sparse, frontier_sparse_next, frontier_size, level, frontier_edges, finished_edges);
+        } else {
+            is_sparse_mode = false;
+            frontier_size = ms_bfs_dense(g, words, dist, seen, visit, visit_next, frontier_dense, level, frontier_edges, finished_edges);
+        }
+        swap(visit, visit_next);
+        unexplored_edges -= finished_edges;
+    }
+    free(seen); free(visit); free(visit_next);
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense);
     return dist;
 }
 
+// picks up to num_roots distinct roots with nonzero out-degree
+vector<VertexId> sample_roots(Graph& g, int num_roots) {
+    vector<VertexId> candidates;
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (g.out_degree(v) > 0) candidates.push_back(v);
+    }
+    VertexId k = min((VertexId) num_roots, (VertexId) candidates.size());
+    // partial Fisher-Yates shuffle
+    for (VertexId i = 0; i < k; i++) {
+        VertexId j = i + rand() % (candidates.size() - i);
+        swap(candidates[i], candidates[j]);
+    }
+    candidates.resize(k);
+    return candidates;
+}
+
+// The five Graph500 validation rules, with edges followed from source to
+// destination only since the graph may be directed:
+// 1. the parent pointers form a tree rooted at root with no cycles
+// 2. tree edges connect vertices whose levels differ by exactly one
+// 3. an edge from a reached vertex leads to a reached vertex at most
+//    one level further
+// 4. the tree spans exactly the vertices reachable from root
+// 5. every tree edge is an edge of the graph
+bool validate(Graph& g, VertexId root, Distance* dist, VertexId* parent) {
+    if (parent[root] != root || dist[root] != 0) return false;
+
+    bool valid = true;
+    # pragma omp parallel for reduction(&& : valid)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        bool reached = dist[v] != INF;
+        // rule 4, together with rule 3 closing the tree under out-edges
+        if (reached != (parent[v] != -1)) {
+            valid = false;
+            continue;
+        }
+        if (!reached) continue;
+
+        // rule 3
+        VertexId* neighbors = g.out_neighbors(v);
+        for (EdgeId j = 0; j < g.out_degree(v); j++) {
+            VertexId w = neighbors[j];
+            if (dist[w] == INF || dist[w] > dist[v] + 1) valid = false;
+        }
+        if (v == root) continue;
+
+        // rules 1 and 2: only the root is at level 0 and levels drop by
+        // one along every parent pointer, so every chain ends at root
+        VertexId p = parent[v];
+        if (dist[v] == 0 || p < 0 || p >= g.num_nodes || dist[p] == INF || dist[v] != dist[p] + 1) {
+            valid = false;
+            continue;
+        }
+
+        // rule 5
+        bool has_edge = false;
+        neighbors = g.in_neighbors(v);
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            if (neighbors[j] == p) {
+                has_edge = true;
+                break;
+            }
+        }
+        if (!has_edge) valid = false;
+    }
+    return valid;
+}
+
+// edges in the traversed component, the numerator of TEPS
+EdgeId traversed_edges(Graph& g, Distance* dist) {
+    EdgeId edges = 0;
+    # pragma omp parallel for reduction(+ : edges)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (dist[v] != INF) edges += g.out_degree(v);
+    }
+    return edges;
+}
+
+// linearly interpolated quantile of sorted data
+double quantile(const vector<double>& sorted, double q) {
+    double pos = q * (sorted.size() - 1);
+    size_t k = (size_t) pos;
+    if (k + 1 >= sorted.size()) return sorted.back();
+    return sorted[k] + (pos - k) * (sorted[k+1] - sorted[k]);
+}
+
+void print_statistics(const string& name, vector<double> data, bool harmonic) {
+    sort(data.begin(), data.end());
+    double n = data.size();
+    double mean = 0, variance = 0;
+    for (double x : data) mean += x / n;
+    for (double x : data) variance += (x - mean) * (x - mean) / max(n - 1, 1.0);
+    cout << "min_" << name << ": " << data.front() << endl;
+    cout << "firstquartile_" << name << ": " << quantile(data, 0.25) << endl;
+    cout << "median_" << name << ": " << quantile(data, 0.5) << endl;
+    cout << "thirdquartile_" << name << ": " << quantile(data, 0.75) << endl;
+    cout << "max_" << name << ": " << data.back() << endl;
+    if (!harmonic) {
+        cout << "mean_" << name << ": " << mean << endl;
+        cout << "stddev_" << name << ": " << sqrt(variance) << endl;
+        return;
+    }
+    // rates are averaged harmonically, as in the Graph500 reference code
+    double inverse_mean = 0, inverse_variance = 0;
+    for (double x : data) inverse_mean += 1.0 / x / n;
+    for (double x : data) inverse_variance += (1.0 / x - inverse_mean) * (1.0 / x - inverse_mean) / max(n - 1, 1.0);
+    cout << "harmonic_mean_" << name << ": " << 1.0 / inverse_mean << endl;
+    cout << "harmonic_stddev_" << name << ": " << sqrt(inverse_variance / n) / (inverse_mean * inverse_mean) << endl;
+}
+
+void graph500(Graph& g) {
+    vector<VertexId> roots = sample_roots(g, graph500_num_roots);
+    if (roots.empty()) {
+        cout << "Graph has no edges" << endl;
+        exit(-1);
+    }
+    VertexId* parent = newA(VertexId, g.num_nodes);
+    vector<double> times, nedges, teps;
+    for (VertexId root : roots) {
+        auto time_before = chrono::system_clock::now();
+        Distance* dist = bfs(g, root, parent);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+
+        // validation is not part of the timed region
+        if (!validate(g, root, dist, parent)) {
+            cerr << "Validation failed for root " << root << endl;
+            exit(-1);
+        }
+        EdgeId edges = traversed_edges(g, dist);
+        times.push_back(delta_time.count());
+        nedges.push_back(edges);
+        teps.push_back(edges / delta_time.count());
+        free(dist);
+    }
+    free(parent);
+
+    cout << "NBFS: " << roots.size() << endl;
+    cout << "num_nodes: " << g.num_nodes << endl;
+    cout << "num_edges: " << g.num_edges << endl;
+    print_statistics("time", times, false);
+    print_statistics("nedge", nedges, false);
+    print_statistics("TEPS", teps, true);
+}
+
 int main(int argc, char *argv[]) {
     if (argc != 3) {
         cout << "Usage: ./bfs <path_to_graph> <num_iter>" << endl;
@@ -159,8 +513,29 @@ int main(int argc, char *argv[]) {
     
     Graph g(argv[1]);
 
-    float current_time = 0.0;
     srand(time(NULL));
+    if (BFS_MODE != nullptr && strcmp(BFS_MODE, "graph500") == 0) {
+        graph500(g);
+        return 0;
+    }
+    if (BFS_MODE != nullptr && strcmp(BFS_MODE, "multisource") == 0) {
+        int batch = max(1, min(ms_bfs_batch, ms_bfs_max_sources));
+        vector<VertexId> sources(batch);
+        double current_time = 0.0;
+        for (int i = 0; i < num_iters; i++) {
+            for (int s = 0; s < batch; s++) sources[s] = rand() % g.num_nodes;
+            auto time_before = chrono::system_clock::now();
+            Distance* scores = ms_bfs(g, sources.data(), batch);
+            auto time_after = chrono::system_clock::now();
+            chrono::duration<double> delta_time = time_after - time_before;
+            current_time += delta_time.count();
+            free(scores);
+        }
+        cout << current_time / num_iters << endl;
+        return 0;
+    }
+
+    double current_time = 0.0;
     for (int i = 0; i < num_iters; i++) {
         VertexId root = rand() % g.num_nodes;
         auto time_before = chrono::system_clock::now();
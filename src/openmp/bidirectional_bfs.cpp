@@ -0,0 +1,172 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "graph.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Point-to-point distances by bidirectional BFS: one search goes forward
+// from s over the out-edges, one backward from t over the in-edges, and
+// every step expands a whole level of the side whose frontier has fewer
+// edges to scan. Once a level reaches a vertex the other side has seen,
+// the shortest path is the best meeting found in that level. A query only
+// touches the vertices both balls cover, and its marks are told apart from
+// the earlier queries' by a timestamp, so no per-query pass over all
+// vertices is needed. Queries run concurrently, each on one thread.
+
+// (s, t) pairs per batch
+const VertexId bibfs_queries = env_double("BIBFS_QUERIES", 64);
+
+// one side of the search: dist[v] is valid while stamp[v] is the current
+// query's
+struct SearchSide {
+    vector<uint32_t> stamp;
+    vector<VertexId> dist;
+    vector<VertexId> frontier;
+    vector<VertexId> frontier_next;
+    EdgeId frontier_edges;
+
+    SearchSide(VertexId n) : stamp(n, 0), dist(n) {}
+
+    bool seen(VertexId v, uint32_t query) const { return stamp[v] == query; }
+
+    void visit(VertexId v, VertexId d, uint32_t query) {
+        stamp[v] = query;
+        dist[v] = d;
+    }
+};
+
+// per-thread state of a query
+struct BidirectionalState {
+    SearchSide forward;
+    SearchSide backward;
+    uint32_t query;
+    VertexId touched;
+
+    BidirectionalState(VertexId n) : forward(n), backward(n), query(0), touched(0) {}
+
+    // a fresh timestamp; the marks are only cleared when they wrap around
+    uint32_t next_query() {
+        if (++query == 0) {
+            fill(forward.stamp.begin(), forward.stamp.end(), 0);
+            fill(backward.stamp.begin(), backward.stamp.end(), 0);
+            query = 1;
+        }
+        return query;
+    }
+};
+
+// expands the frontier of side by one level, over the out-edges if
+// forward and the in-edges otherwise. Returns the shortest s-t distance
+// through the vertices of other reached by this level, or -1
+VertexId expand_level(Graph& g, SearchSide& side, const SearchSide& other, bool forward, uint32_t query, VertexId& touched) {
+    VertexId best = -1;
+    side.frontier_next.clear();
+    side.frontier_edges = 0;
+    for (VertexId u : side.frontier) {
+        VertexId d = side.dist[u] + 1;
+        VertexId* neighbors = forward ? g.out_neighbors(u) : g.in_neighbors(u);
+        EdgeId degree = forward ? g.out_degree(u) : g.in_degree(u);
+        for (EdgeId j = 0; j < degree; j++) {
+            VertexId v = neighbors[j];
+            if (side.seen(v, query)) continue;
+            side.visit(v, d, query);
+            touched++;
+            if (other.seen(v, query)) {
+                VertexId through = d + other.dist[v];
+                if (best < 0 || through < best) best = through;
+            }
+            side.frontier_next.push_back(v);
+            side.frontier_edges += forward ? g.out_degree(v) : g.in_degree(v);
+        }
+    }
+    swap(side.frontier, side.frontier_next);
+    return best;
+}
+
+// the length of a shortest path from s to t, or -1 if there is none
+VertexId bidirectional_bfs(Graph& g, VertexId s, VertexId t, BidirectionalState& state) {
+    uint32_t query = state.next_query();
+    SearchSide& forward = state.forward;
+    SearchSide& backward = state.backward;
+    state.touched = 2;
+    if (s == t) return 0;
+
+    forward.visit(s, 0, query);
+    forward.frontier.assign(1, s);
+    forward.frontier_edges = g.out_degree(s);
+    backward.visit(t, 0, query);
+    backward.frontier.assign(1, t);
+    backward.frontier_edges = g.in_degree(t);
+
+    // either side running dry means t is out of reach
+    while (!forward.frontier.empty() && !backward.frontier.empty()) {
+        VertexId found;
+        if (forward.frontier_edges <= backward.frontier_edges) {
+            found = expand_level(g, forward, backward, true, query, state.touched);
+        } else {
+            found = expand_level(g, backward, forward, false, query, state.touched);
+        }
+        if (found >= 0) return found;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./bidirectional_bfs <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    srand(time(NULL));
+    vector<BidirectionalState*> states(omp_get_max_threads());
+    for (size_t i = 0; i < states.size(); i++) {
+        states[i] = new BidirectionalState(g.num_nodes);
+    }
+
+    vector<pair<VertexId, VertexId>> pairs(bibfs_queries);
+    VertexId reachable = 0;
+    double distance_sum = 0, touched = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        for (VertexId q = 0; q < bibfs_queries; q++) {
+            pairs[q] = make_pair(rand() % g.num_nodes, rand() % g.num_nodes);
+        }
+        auto time_before = chrono::system_clock::now();
+        # pragma omp parallel for schedule(dynamic, 1) reduction(+ : reachable, distance_sum, touched)
+        for (VertexId q = 0; q < bibfs_queries; q++) {
+            BidirectionalState& state = *states[omp_get_thread_num()];
+            VertexId d = bidirectional_bfs(g, pairs[q].first, pairs[q].second, state);
+            if (d >= 0) {
+                reachable++;
+                distance_sum += d;
+            }
+            touched += state.touched;
+        }
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+    }
+
+    for (BidirectionalState* state : states) {
+        delete state;
+    }
+
+    cout << "queries: " << bibfs_queries << endl;
+    cout << "reachable: " << (double) reachable / num_iters << endl;
+    cout << "mean_distance: " << (reachable > 0 ? distance_sum / reachable : 0) << endl;
+    cout << "touched_per_query: " << touched / bibfs_queries / num_iters << endl;
+    cout << "queries_per_second: " << bibfs_queries * num_iters / current_time << endl;
+    cout << current_time / num_iters << endl;
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+#include "graph.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Distance-1 coloring of a symmetric graph by speculative first-fit with
+// iterative conflict resolution (Gebremedhin and Manne, "Scalable Parallel
+// Graph Coloring Algorithms"). Every vertex of the frontier takes the
+// smallest color none of its neighbors has, reading colors other threads
+// may be setting at the same time; of two neighbors that ended up with the
+// same color, the one with the larger id is recolored in the next round.
+// The conflicts are few, so the frontier shrinks fast.
+
+typedef int Color;
+
+struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+
+// the frontier is kept sparse while it is under this fraction of the vertices
+const int threshold_fraction_denom = 20;
+
+// the smallest color none of u's neighbors has. forbidden is the calling
+// thread's bitset, all clear on entry and exit; only the first
+// degree + 1 colors can be the answer, so larger ones are not tracked
+inline Color first_fit(Graph& g, VertexId u, const Color* colors, vector<uint64_t>& forbidden) {
+    EdgeId degree = g.out_degree(u);
+    size_t num_words = degree / 64 + 1;
+    if (forbidden.size() < num_words) forbidden.resize(num_words, 0);
+
+    VertexId* neighbors = g.out_neighbors(u);
+    for (EdgeId j = 0; j < degree; j++) {
+        Color c = relaxed_load(&colors[neighbors[j]]);
+        if (c >= 0 && c <= degree) forbidden[c / 64] |= 1UL << (c % 64);
+    }
+    Color color = -1;
+    for (size_t w = 0; w < num_words; w++) {
+        if (color < 0 && ~forbidden[w] != 0) color = w * 64 + __builtin_ctzll(~forbidden[w]);
+        forbidden[w] = 0;
+    }
+    return color;
+}
+
+// a neighbor with a smaller id took the same color
+inline bool has_conflict(Graph& g, VertexId u, const Color* colors) {
+    VertexId* neighbors = g.out_neighbors(u);
+    for (EdgeId j = 0; j < g.out_degree(u); j++) {
+        VertexId v = neighbors[j];
+        if (v < u && colors[v] == colors[u]) return true;
+    }
+    return false;
+}
+
+VertexId coloring_sparse(Graph& g, Color* colors, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size) {
+    # pragma omp parallel
+    {
+        vector<uint64_t> forbidden;
+        # pragma omp for schedule(dynamic, 64)
+        for (VertexId i = 0; i < frontier_size; i++) {
+            relaxed_store(&colors[frontier[i]], first_fit(g, frontier[i], colors, forbidden));
+        }
+    }
+
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        frontier_next[i] = has_conflict(g, u, colors) ? u : -1;
+    }
+
+    frontier_size = sequence::filter(frontier_next, frontier, frontier_size, nonNegF());
+    return frontier_size;
+}
+
+VertexId coloring_dense(Graph& g, Color* colors, bool* frontier, bool* frontier_next) {
+    # pragma omp parallel
+    {
+        vector<uint64_t> forbidden;
+        # pragma omp for schedule(dynamic, 1024)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            if (frontier[u]) relaxed_store(&colors[u], first_fit(g, u, colors, forbidden));
+        }
+    }
+
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        frontier_next[u] = frontier[u] && has_conflict(g, u, colors);
+    }
+    return sequence::sumFlagsSerial(frontier_next, g.num_nodes);
+}
+
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    # pragma omp parallel for
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        frontier_dense[frontier_sparse[i]] = true;
+    }
+}
+
+void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
+}
+
+Color* coloring(Graph& g) {
+    Color* colors = newA(Color, g.num_nodes);
+
+    VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
+    VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
+    bool* frontier_dense = newA(bool, g.num_nodes);
+    bool* frontier_dense_next = newA(bool, g.num_nodes);
+
+    // every vertex starts out in the frontier
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        colors[i] = -1;
+        frontier_dense[i] = true;
+    }
+    VertexId frontier_size = g.num_nodes;
+    bool is_sparse_mode = false;
+
+    VertexId round = 0;
+    while (frontier_size != 0) {
+        round++;
+        bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+        if (DEBUG) cout << "Round " << round << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+        if (should_be_sparse_mode) {
+            if (!is_sparse_mode) {
+                dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+            }
+            is_sparse_mode = true;
+            frontier_size = coloring_sparse(g, colors, frontier_sparse, frontier_sparse_next, frontier_size);
+        } else {
+            if (is_sparse_mode) {
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
+            }
+            is_sparse_mode = false;
+            frontier_size = coloring_dense(g, colors, frontier_dense, frontier_dense_next);
+            swap(frontier_dense, frontier_dense_next);
+        }
+    }
+
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next);
+    return colors;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./coloring <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    Color num_colors = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        Color* colors = coloring(g);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        num_colors = g.num_nodes > 0 ? *max_element(colors, colors + g.num_nodes) + 1 : 0;
+        free(colors);
+    }
+
+    cout << "colors: " << num_colors << endl;
+    cout << current_time / num_iters << endl;
+}
@@ -0,0 +1,462 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+#include "graph.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Community detection on a symmetric graph. The default is label
+// propagation (Raghavan, Albert and Kumara, "Near linear time algorithm to
+// detect community structures in large-scale networks"): every vertex
+// takes the label most of its neighbors have, in place, until no label
+// changes. COMMUNITY_MODE=louvain runs the Louvain method (Blondel et al.,
+// "Fast unfolding of communities in large networks") instead: vertices
+// move to the neighboring community with the largest modularity gain
+// until the gains run out, the communities are contracted into the
+// vertices of a smaller weighted graph, and the next level starts over on
+// that graph. Both count the neighbors' labels or communities in a
+// per-thread hash table sized to the vertex at hand.
+const char* COMMUNITY_MODE = std::getenv("COMMUNITY_MODE");
+
+// label propagation stops after LP_MAX_ITERS rounds even if labels still
+// change, which they can keep doing on near-bipartite parts of the graph
+const int lp_max_iters = env_double("LP_MAX_ITERS", 20);
+// a Louvain level ends once a sweep gains less modularity than
+// LOUVAIN_MIN_GAIN, and so does the whole method once a level does
+const double louvain_min_gain = env_double("LOUVAIN_MIN_GAIN", 1e-6);
+// bounds the sweeps of a level, which stale reads can keep going
+const int louvain_max_sweeps = 100;
+
+// open addressing from labels to running sums. It only grows, and is
+// cleared through the list of the slots in use
+template <class V>
+struct HashCounter {
+    vector<VertexId> keys;
+    vector<V> sums;
+    vector<size_t> used;
+
+    // room for n distinct keys; the table must be empty
+    void reserve(EdgeId n) {
+        size_t capacity = 16;
+        while (capacity < 2 * (size_t) n) capacity *= 2;
+        if (keys.size() < capacity) {
+            keys.assign(capacity, -1);
+            sums.assign(capacity, 0);
+        }
+    }
+
+    void add(VertexId key, V x) {
+        size_t mask = keys.size() - 1;
+        size_t i = utils::hash(key) & mask;
+        while (keys[i] != key && keys[i] != -1) i = (i + 1) & mask;
+        if (keys[i] == -1) {
+            keys[i] = key;
+            used.push_back(i);
+        }
+        sums[i] += x;
+    }
+
+    void clear() {
+        for (size_t i : used) {
+            keys[i] = -1;
+            sums[i] = 0;
+        }
+        used.clear();
+    }
+};
+
+// hashed order of the labels as u sees them, ties broken by id. Mixing in
+// u keeps one label from winning every tie in the graph and sweeping
+// across community borders in the first rounds
+inline bool higher_priority(VertexId a, VertexId b, VertexId u) {
+    unsigned int ha = utils::hash(a ^ utils::hash(u)), hb = utils::hash(b ^ utils::hash(u));
+    return ha > hb || (ha == hb && a > b);
+}
+
+// the label most of u's neighbors have. u keeps its own if that is one of
+// the most frequent, otherwise the one first in u's hashed order wins
+inline VertexId most_frequent_label(Graph& g, VertexId u, const VertexId* labels, HashCounter<EdgeId>& counts) {
+    VertexId own = relaxed_load(&labels[u]);
+    EdgeId degree = g.out_degree(u);
+    counts.reserve(degree);
+    VertexId* neighbors = g.out_neighbors(u);
+    for (EdgeId j = 0; j < degree; j++) {
+        if (neighbors[j] != u) counts.add(relaxed_load(&labels[neighbors[j]]), 1);
+    }
+
+    VertexId best = own;
+    EdgeId best_count = 0, own_count = 0;
+    for (size_t i : counts.used) {
+        VertexId label = counts.keys[i];
+        EdgeId count = counts.sums[i];
+        if (label == own) own_count = count;
+        if (count > best_count || (count == best_count && higher_priority(label, best, u))) {
+            best = label;
+            best_count = count;
+        }
+    }
+    counts.clear();
+    return own_count == best_count ? own : best;
+}
+
+// updates the labels of the active vertices in place; the neighbors of the
+// ones that changed are active in the next round. Returns how many changed
+VertexId label_propagation_round(Graph& g, VertexId* labels, bool* active, bool* active_next) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        active_next[i] = false;
+    }
+
+    VertexId num_changed = 0;
+    # pragma omp parallel reduction(+:num_changed)
+    {
+        HashCounter<EdgeId> counts;
+        # pragma omp for schedule(dynamic, 64)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            if (!active[u]) continue;
+            VertexId label = most_frequent_label(g, u, labels, counts);
+            if (label == labels[u]) continue;
+            relaxed_store(&labels[u], label);
+            num_changed++;
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                VertexId v = neighbors[j];
+                if (!relaxed_load(&active_next[v])) relaxed_store(&active_next[v], true);
+            }
+        }
+    }
+    return num_changed;
+}
+
+VertexId* label_propagation(Graph& g) {
+    VertexId* labels = newA(VertexId, g.num_nodes);
+    bool* active = newA(bool, g.num_nodes);
+    bool* active_next = newA(bool, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        labels[i] = i;
+        active[i] = true;
+    }
+
+    VertexId round = 0;
+    VertexId num_changed = g.num_nodes;
+    while (num_changed != 0 && round < lp_max_iters) {
+        round++;
+        num_changed = label_propagation_round(g, labels, active, active_next);
+        swap(active, active_next);
+        if (DEBUG) cout << "Round " << round << " | " << "Changed: " << num_changed << endl;
+    }
+
+    free(active); free(active_next);
+    return labels;
+}
+
+// the graph of a Louvain level: its vertices are the communities of the
+// level below and its edges carry the summed weights of the edges between
+// them. A self loop holds the weight inside a community, counted from both
+// ends, so a degree is the sum of its row, self loop included
+struct CommunityGraph {
+    VertexId num_nodes;
+    vector<EdgeId> offsets;
+    vector<VertexId> edges;
+    vector<double> weights;
+    vector<double> degrees;
+};
+
+CommunityGraph community_graph(Graph& g) {
+    CommunityGraph cg;
+    cg.num_nodes = g.num_nodes;
+    cg.offsets.resize(g.num_nodes + 1);
+    cg.edges.resize(g.num_edges);
+    cg.weights.resize(g.num_edges);
+    cg.degrees.resize(g.num_nodes);
+
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        EdgeId offset = g.out_neighbors(u) - g.out_neighbors(0);
+        cg.offsets[u] = offset;
+        memcpy(cg.edges.data() + offset, g.out_neighbors(u), g.out_degree(u) * sizeof(VertexId));
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            cg.weights[offset + j] = 1.0;
+        }
+        cg.degrees[u] = g.out_degree(u);
+    }
+    cg.offsets[g.num_nodes] = g.num_edges;
+    return cg;
+}
+
+// moves the vertices of cg between communities in place, each to the
+// neighboring community that gains the most modularity. total_weight is
+// the sum of the degrees. Returns the modularity gained
+double local_moves(const CommunityGraph& cg, VertexId* community, double* community_degree, VertexId* community_size, double total_weight) {
+    double level_gain = 0;
+    for (int sweep = 1; sweep <= louvain_max_sweeps; sweep++) {
+        double gain = 0;
+        VertexId num_moved = 0;
+        # pragma omp parallel reduction(+:gain, num_moved)
+        {
+            HashCounter<double> links;
+            # pragma omp for schedule(dynamic, 64)
+            for (VertexId u = 0; u < cg.num_nodes; u++) {
+                VertexId own = community[u];
+                double k = cg.degrees[u];
+                links.reserve(cg.offsets[u + 1] - cg.offsets[u] + 1);
+                // staying put is always an option, even with no link to the rest
+                links.add(own, 0);
+                for (EdgeId e = cg.offsets[u]; e < cg.offsets[u + 1]; e++) {
+                    VertexId v = cg.edges[e];
+                    if (v != u) links.add(relaxed_load(&community[v]), cg.weights[e]);
+                }
+
+                // joining c gains 2 / total_weight times the links to c less
+                // k times the degree of c without u over total_weight, beyond
+                // what leaving own costs
+                VertexId best = -1;
+                double best_score = 0, own_score = 0;
+                for (size_t i : links.used) {
+                    VertexId c = links.keys[i];
+                    double degree = relaxed_load(&community_degree[c]) - (c == own ? k : 0);
+                    double score = links.sums[i] - k * degree / total_weight;
+                    if (c == own) own_score = score;
+                    if (best < 0 || score > best_score || (score == best_score && c < best)) {
+                        best = c;
+                        best_score = score;
+                    }
+                }
+                links.clear();
+                if (best == own || best_score <= own_score) continue;
+                // two singletons would swap into each other's community over
+                // and over, so a singleton only joins another one with a
+                // smaller id
+                if (relaxed_load(&community_size[own]) == 1 && relaxed_load(&community_size[best]) == 1 && best > own) continue;
+
+                utils::writeAdd(&community_degree[own], -k);
+                utils::writeAdd(&community_degree[best], k);
+                utils::writeAdd(&community_size[own], (VertexId) -1);
+                utils::writeAdd(&community_size[best], (VertexId) 1);
+                relaxed_store(&community[u], best);
+                gain += 2 * (best_score - own_score) / total_weight;
+                num_moved++;
+            }
+        }
+        level_gain += gain;
+        if (DEBUG) cout << "Sweep " << sweep << " | " << "Moved: " << num_moved << " | Gain: " << gain << endl;
+        if (num_moved == 0 || gain < louvain_min_gain) break;
+    }
+    return level_gain;
+}
+
+// contracts every community of cg into a vertex of the next level.
+// Afterwards community maps the vertices of cg to the vertices of the next
+// level
+CommunityGraph coarsen(const CommunityGraph& cg, VertexId* community) {
+    VertexId n = cg.num_nodes;
+    VertexId* ids = newA(VertexId, n);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < n; i++) {
+        ids[i] = 0;
+    }
+    # pragma omp parallel for
+    for (VertexId u = 0; u < n; u++) {
+        ids[community[u]] = 1;
+    }
+    VertexId num_communities = sequence::plusScan(ids, ids, n);
+    # pragma omp parallel for
+    for (VertexId u = 0; u < n; u++) {
+        community[u] = ids[community[u]];
+    }
+    free(ids);
+
+    // the members of every community, by a counting sort. It is linear in
+    // the vertices, the contraction below in the edges
+    vector<VertexId> member_offsets(num_communities + 1, 0);
+    vector<VertexId> members(n);
+    for (VertexId u = 0; u < n; u++) {
+        member_offsets[community[u] + 1]++;
+    }
+    for (VertexId c = 0; c < num_communities; c++) {
+        member_offsets[c + 1] += member_offsets[c];
+    }
+    vector<VertexId> position(member_offsets.begin(), member_offsets.end() - 1);
+    for (VertexId u = 0; u < n; u++) {
+        members[position[community[u]]++] = u;
+    }
+
+    CommunityGraph next;
+    next.num_nodes = num_communities;
+    next.offsets.resize(num_communities + 1);
+    next.degrees.resize(num_communities);
+
+    // one pass counts the neighboring communities of every community, a
+    // second one writes the summed edges in the same order
+    for (int pass = 0; pass < 2; pass++) {
+        # pragma omp parallel
+        {
+            HashCounter<double> links;
+            # pragma omp for schedule(dynamic, 64)
+            for (VertexId c = 0; c < num_communities; c++) {
+                EdgeId num_links = 0;
+                for (VertexId i = member_offsets[c]; i < member_offsets[c + 1]; i++) {
+                    num_links += cg.offsets[members[i] + 1] - cg.offsets[members[i]];
+                }
+                links.reserve(num_links);
+                for (VertexId i = member_offsets[c]; i < member_offsets[c + 1]; i++) {
+                    VertexId u = members[i];
+                    for (EdgeId e = cg.offsets[u]; e < cg.offsets[u + 1]; e++) {
+                        links.add(community[cg.edges[e]], cg.weights[e]);
+                    }
+                }
+
+                if (pass == 0) {
+                    next.offsets[c] = links.used.size();
+                } else {
+                    EdgeId offset = next.offsets[c];
+                    double degree = 0;
+                    for (size_t i : links.used) {
+                        next.edges[offset] = links.keys[i];
+                        next.weights[offset] = links.sums[i];
+                        degree += links.sums[i];
+                        offset++;
+                    }
+                    next.degrees[c] = degree;
+                }
+                links.clear();
+            }
+        }
+
+        if (pass == 0) {
+            next.offsets[num_communities] = 0;
+            EdgeId m = sequence::plusScan(next.offsets.data(), next.offsets.data(), num_communities + 1);
+            next.edges.resize(m);
+            next.weights.resize(m);
+        }
+    }
+    return next;
+}
+
+VertexId* louvain(Graph& g) {
+    VertexId* labels = newA(VertexId, g.num_nodes);
+    VertexId* community = newA(VertexId, g.num_nodes);
+    double* community_degree = newA(double, g.num_nodes);
+    VertexId* community_size = newA(VertexId, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        labels[i] = i;
+    }
+    CommunityGraph cg = community_graph(g);
+    double total_weight = g.num_edges;
+    if (total_weight == 0) {
+        free(community); free(community_degree); free(community_size);
+        return labels;
+    }
+
+    VertexId level = 0;
+    while (true) {
+        level++;
+        # pragma omp parallel for
+        for (VertexId u = 0; u < cg.num_nodes; u++) {
+            community[u] = u;
+            community_degree[u] = cg.degrees[u];
+            community_size[u] = 1;
+        }
+        double gain = local_moves(cg, community, community_degree, community_size, total_weight);
+        CommunityGraph next = coarsen(cg, community);
+
+        // labels maps the original vertices to the vertices of the level
+        # pragma omp parallel for
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            labels[v] = community[labels[v]];
+        }
+        if (DEBUG) cout << "Level " << level << " | " << "Communities: " << next.num_nodes << " | Gain: " << gain << endl;
+
+        bool done = next.num_nodes == cg.num_nodes || gain < louvain_min_gain;
+        cg = move(next);
+        if (done) break;
+    }
+
+    free(community); free(community_degree); free(community_size);
+    return labels;
+}
+
+// modularity of the partition into labels, every edge of weight one
+double modularity(Graph& g, const VertexId* labels) {
+    double total_weight = g.num_edges;
+    if (total_weight == 0) return 0;
+    double* community_degree = newA(double, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        community_degree[i] = 0;
+    }
+
+    EdgeId internal = 0;
+    # pragma omp parallel for schedule(dynamic, 1024) reduction(+:internal)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        utils::writeAdd(&community_degree[labels[u]], (double) g.out_degree(u));
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            if (labels[neighbors[j]] == labels[u]) internal++;
+        }
+    }
+
+    double expected = 0;
+    # pragma omp parallel for reduction(+:expected)
+    for (VertexId c = 0; c < g.num_nodes; c++) {
+        expected += (community_degree[c] / total_weight) * (community_degree[c] / total_weight);
+    }
+    free(community_degree);
+    return internal / total_weight - expected;
+}
+
+VertexId count_communities(Graph& g, const VertexId* labels) {
+    bool* is_label = newA(bool, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        is_label[i] = false;
+    }
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        is_label[labels[u]] = true;
+    }
+    VertexId num_communities = sequence::sumFlagsSerial(is_label, g.num_nodes);
+    free(is_label);
+    return num_communities;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./communities <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    bool use_louvain = COMMUNITY_MODE != nullptr && strcmp(COMMUNITY_MODE, "louvain") == 0;
+    VertexId num_communities = 0;
+    double q = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        VertexId* labels = use_louvain ? louvain(g) : label_propagation(g);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        num_communities = count_communities(g, labels);
+        q = modularity(g, labels);
+        free(labels);
+    }
+
+    cout << "communities: " << num_communities << endl;
+    cout << "modularity: " << q << endl;
+    cout << current_time / num_iters << endl;
+}
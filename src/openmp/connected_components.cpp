@@ -6,80 +6,45 @@
 #include <vector>
 #include <queue>
 #include <climits>
+#include <cstring>
+#include <unordered_map>
 
 #include "graph.hpp"
 #include "sequence.hpp"
+#include "semiring.hpp"
 #include "utils.hpp"
 
 using namespace std;
 
-struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
 struct trueF{bool operator() (bool a) {return a;}};
 
-VertexId cc_sparse(Graph& g, VertexId* labels, VertexId* labels_next, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId level) {
-    // update labels_next to take labels's values
-    // also reset visited 
-    # pragma omp parallel for
-    for (VertexId i = 0; i < g.num_nodes; i++) {
-        labels_next[i] = labels[i];
-        frontier_next[i] = -1;
-    }
-
-    # pragma omp parallel for
-    for (VertexId i = 0; i < frontier_size; i++) {
-        VertexId u = frontier[i];
-        VertexId* neighbors = g.out_neighbors(u);
-        for (EdgeId j = 0; j < g.out_degree(u); j++) {
-            VertexId v = neighbors[j];
-            if (priority_update(&labels_next[v], labels[u])) {
-                frontier_next[v] = v;
-            }
-        }       
-    }
+// CC_MODE=afforest selects Afforest instead of label propagation,
+// CC_MODE=async label propagation by in-place sweeps
+const char* CC_MODE = std::getenv("CC_MODE");
+// neighbors per vertex linked before sampling the largest component
+const int afforest_neighbor_rounds = 2;
+const int afforest_num_samples = 1024;
 
-    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
-    return frontier_size;
+// a round lowers the labels of the out-neighbors of the frontier to the
+// smallest label among their frontier in-neighbors, over (min, select):
+// pushing from a sparse frontier and pulling into every vertex from a
+// dense one. labels only ever decrease, so they are both the input and the
+// output vector, lowered in place
+VertexId cc_sparse(Graph& g, VertexId* labels, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, bool* claimed) {
+    return semiring::spmspv<semiring::MinSelect<VertexId>>(g, labels, frontier, frontier_size, labels, nullptr, frontier_next, claimed);
 }
 
-VertexId cc_dense(Graph& g, VertexId* labels, VertexId* labels_next, bool* frontier, bool* frontier_next, VertexId level) {
-    auto time_before = chrono::system_clock::now();
-    # pragma omp parallel for
-    for (VertexId i = 0; i < g.num_nodes; i++) {
-        frontier_next[i] = false;
-        labels_next[i] = labels[i];
-    }
-    auto time_after_1 = chrono::system_clock::now();
-    chrono::duration<double> delta = time_after_1 - time_before; 
-    if (DEBUG)
-        cout << "Time for setting labels_next " << delta.count() << endl;
+VertexId cc_dense(Graph& g, VertexId* labels, bool* frontier, bool* frontier_next) {
+    return semiring::spmv<semiring::MinSelect<VertexId>>(g, labels, frontier, labels, nullptr, true, frontier_next);
+}
 
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
     # pragma omp parallel for
-    for (VertexId u = 0; u < g.num_nodes; u++) {
-        VertexId* neighbors = g.in_neighbors(u);
-        for (EdgeId j = 0; j < g.in_degree(u); j++) {
-            VertexId v = neighbors[j];
-            if (!frontier[v]) continue; // ignore non-frontiers
-            if (labels_next[u] > labels[v]) {
-                labels_next[u] = labels[v];
-                if (!frontier_next[u]) frontier_next[u] = true;
-            }
-        }
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
     }
-    auto time_after_2 = chrono::system_clock::now();
-    delta = time_after_2 - time_after_1; 
-    if (DEBUG)
-        cout << "Time for looping " << delta.count() << endl;
 
-    VertexId frontier_size = sequence::sumFlagsSerial(frontier_next, g.num_nodes);
-
-    auto time_after_3 = chrono::system_clock::now();
-    delta = time_after_3 - time_after_2;
-    if (DEBUG) 
-        cout << "Time for summing flags " << delta.count() << endl;
-    return frontier_size;
-}
-
-void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
     # pragma omp parallel for
     for (VertexId i = 0; i < frontier_size; i++) {
         frontier_dense[frontier_sparse[i]] = true;
@@ -87,29 +52,24 @@ void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* fr
 }
 
 void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
-    # pragma omp parallel for
-    for (VertexId i = 0; i < num_nodes; i++) {
-        if (frontier_dense[i]) {
-            frontier_sparse[i] = i;
-        } else {
-            frontier_sparse[i] = -1;
-        }
-    }
-    sequence::filter(frontier_sparse, frontier_sparse, num_nodes, nonNegF());
+    // pack straight from the flags; filtering frontier_sparse onto itself
+    // races between blocks in the parallel pack
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
 }
 
 VertexId* cc(Graph& g) {
     VertexId* labels = newA(VertexId, g.num_nodes);
-    VertexId* labels_next = newA(VertexId, g.num_nodes);
 
     VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
     VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
     bool* frontier_dense = newA(bool, g.num_nodes);
     bool* frontier_dense_next = newA(bool, g.num_nodes);
+    bool* claimed = newA(bool, g.num_nodes);
     # pragma omp parallel for
     for (VertexId i = 0; i < g.num_nodes; i++) {
         labels[i] = i; // set as own group
         frontier_sparse[i] = i;
+        claimed[i] = false;
     }
 
     VertexId frontier_size = g.num_nodes;
@@ -130,26 +90,144 @@ VertexId* cc(Graph& g) {
                 dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
             }
             is_sparse_mode = true;
-            frontier_size = cc_sparse(g, labels, labels_next, frontier_sparse, frontier_sparse_next, frontier_size, level);
+            frontier_size = cc_sparse(g, labels, frontier_sparse, frontier_sparse_next, frontier_size, claimed);
+            swap(frontier_sparse, frontier_sparse_next);
         } else {
             if (is_sparse_mode) {
-                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
             }
             is_sparse_mode = false;
-            frontier_size = cc_dense(g, labels, labels_next, frontier_dense, frontier_dense_next, level);
+            frontier_size = cc_dense(g, labels, frontier_dense, frontier_dense_next);
             swap(frontier_dense, frontier_dense_next);
         }
-        swap(labels_next, labels); 
 
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
         if (DEBUG) cout << "Time: " << delta.count() << endl;
         
     }
-    free(labels_next); free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next); 
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next); free(claimed);
     return labels;
 }
 
+// Asynchronous (Gauss-Seidel) label propagation: every sweep lowers each
+// label to the smallest of its in-neighbors' labels in place, so a lowered
+// label already reaches the vertices after it within the same sweep. Only
+// u's iteration writes labels[u], but others read it meanwhile, hence the
+// relaxed atomics. Done once a sweep changes nothing.
+VertexId* cc_async(Graph& g) {
+    VertexId* labels = newA(VertexId, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        labels[i] = i;
+    }
+
+    VertexId num_changed = 1;
+    VertexId sweep = 0;
+    while (num_changed != 0) {
+        sweep++;
+        num_changed = 0;
+        # pragma omp parallel for schedule(dynamic, 1024) reduction(+ : num_changed)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            VertexId label = labels[u];
+            VertexId* neighbors = g.in_neighbors(u);
+            for (EdgeId j = 0; j < g.in_degree(u); j++) {
+                label = min(label, relaxed_load(&labels[neighbors[j]]));
+            }
+            if (label < labels[u]) {
+                relaxed_store(&labels[u], label);
+                num_changed++;
+            }
+        }
+        if (DEBUG) cout << "Sweep " << sweep << " | " << "Changed: " << num_changed << endl;
+    }
+    return labels;
+}
+
+// Afforest (Sutton et al., "Optimizing Parallel Graph Connectivity
+// Computation via Subgraph Sampling"), following the GAP benchmark suite's
+// cc.cc: link a couple of neighbors per vertex in a lock-free union-find,
+// find the component most vertices already joined, and only process the
+// remaining edges of vertices outside of it.
+
+// hooks the higher of the two roots under the lower one with a CAS,
+// retrying from the grandparents if another thread got there first. As
+// roots only ever move under smaller ids, every component ends up rooted
+// at its smallest vertex, the same labels label propagation produces.
+void link(VertexId u, VertexId v, VertexId* comp) {
+    VertexId p1 = comp[u];
+    VertexId p2 = comp[v];
+    while (p1 != p2) {
+        VertexId high = max(p1, p2);
+        VertexId low = min(p1, p2);
+        VertexId p_high = comp[high];
+        if (p_high == low || (p_high == high && compare_and_swap(&comp[high], high, low))) break;
+        p1 = comp[comp[high]];
+        p2 = comp[low];
+    }
+}
+
+// full path compression, afterwards comp[u] is u's root
+void compress(Graph& g, VertexId* comp) {
+    # pragma omp parallel for schedule(dynamic, 16384)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        while (comp[u] != comp[comp[u]]) {
+            comp[u] = comp[comp[u]];
+        }
+    }
+}
+
+// most frequent root among a random sample of vertices
+VertexId sample_frequent_element(Graph& g, VertexId* comp) {
+    unordered_map<VertexId, int> counts;
+    for (int i = 0; i < afforest_num_samples; i++) {
+        counts[comp[rand() % g.num_nodes]]++;
+    }
+    auto most_frequent = counts.begin();
+    for (auto it = counts.begin(); it != counts.end(); it++) {
+        if (it->second > most_frequent->second) most_frequent = it;
+    }
+    if (DEBUG) cout << "Largest intermediate component " << most_frequent->first << " | ~" << (double) most_frequent->second / afforest_num_samples << " of the vertices" << endl;
+    return most_frequent->first;
+}
+
+VertexId* afforest(Graph& g) {
+    VertexId* comp = newA(VertexId, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        comp[i] = i;
+    }
+
+    // link the r-th out-neighbor of every vertex
+    for (int r = 0; r < afforest_neighbor_rounds; r++) {
+        # pragma omp parallel for schedule(dynamic, 16384)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            if (r < g.out_degree(u)) link(u, g.out_neighbors(u)[r], comp);
+        }
+        compress(g, comp);
+    }
+
+    VertexId c = sample_frequent_element(g, comp);
+
+    // finish the vertices outside of c. Linking their in-neighbors too
+    // covers edges from c into them, so directed graphs get their weakly
+    // connected components
+    # pragma omp parallel for schedule(dynamic, 16384)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        if (comp[u] == c) continue;
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = afforest_neighbor_rounds; j < g.out_degree(u); j++) {
+            link(u, neighbors[j], comp);
+        }
+        neighbors = g.in_neighbors(u);
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            link(u, neighbors[j], comp);
+        }
+    }
+    compress(g, comp);
+    return comp;
+}
+
 bool verify(Graph& g, VertexId* labels_new) {
     VertexId* labels = newA(VertexId, g.num_nodes);
     VertexId* labels_next = newA(VertexId, g.num_nodes);
@@ -218,10 +296,13 @@ int main(int argc, char *argv[]) {
     
     Graph g(argv[1]);
     int num_iters = atoi(argv[2]);
-    float current_time = 0.0;
+    bool use_afforest = CC_MODE != nullptr && strcmp(CC_MODE, "afforest") == 0;
+    bool use_async = CC_MODE != nullptr && strcmp(CC_MODE, "async") == 0;
+    srand(time(NULL));
+    double current_time = 0.0;
     for (int i = 0; i < num_iters; i++) {
         auto time_before = chrono::system_clock::now();
-        VertexId* labels = cc(g);
+        VertexId* labels = use_afforest ? afforest(g) : use_async ? cc_async(g) : cc(g);
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta_time = time_after - time_before;
         current_time += delta_time.count();
@@ -0,0 +1,209 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+
+#include "graph_weighted.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Delta-stepping SSSP (Meyer and Sanders, "Delta-stepping: a
+// parallelizable shortest path algorithm"). Vertices are kept in buckets of
+// width delta by tentative distance; light edges (weight <= delta) of the
+// lowest bucket are relaxed until it stays empty, then the heavy edges of
+// every vertex it settled are relaxed once. Buckets are thread-local and a
+// thread keeps draining its own copy of the current bucket while it is
+// small, as in the GAP benchmark suite's sssp.cc, to save barriers.
+
+const size_t max_bin = ULONG_MAX / 2;
+const size_t fusion_threshold = 1000;
+
+// SSSP_DELTA sets the bucket width; otherwise it is chosen from the graph
+const double SSSP_DELTA = env_double("SSSP_DELTA", 0);
+
+// the largest weight over the average degree, Meyer and Sanders' choice
+// for uniformly random weights
+Weight choose_delta(Graph& g) {
+    if (SSSP_DELTA >= 1) return (Weight) SSSP_DELTA;
+    Weight max_weight = 0;
+    # pragma omp parallel for reduction(max : max_weight)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        Weight* weights = g.out_weights_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            max_weight = max(max_weight, weights[j]);
+        }
+    }
+    if (g.num_edges == 0) return 1;
+    return max((Weight) 1, max_weight * g.num_nodes / g.num_edges);
+}
+
+// relaxes u's light or heavy edges, queueing improved vertices in the
+// calling thread's buckets; returns the number of edges relaxed
+EdgeId relax_edges(Graph& g, VertexId u, Weight delta, bool light, Weight* dist, vector<vector<VertexId>>& local_bins) {
+    VertexId* neighbors = g.out_neighbors(u);
+    Weight* weights = g.out_weights_neighbors(u);
+    EdgeId relaxed = 0;
+    for (EdgeId j = 0; j < g.out_degree(u); j++) {
+        if ((weights[j] <= delta) != light) continue;
+        relaxed++;
+        VertexId v = neighbors[j];
+        Weight relax_dist = dist[u] + weights[j];
+        if (priority_update(&dist[v], relax_dist)) {
+            size_t dest_bin = relax_dist / delta;
+            if (dest_bin >= local_bins.size()) local_bins.resize(dest_bin + 1);
+            local_bins[dest_bin].push_back(v);
+        }
+    }
+    return relaxed;
+}
+
+// concatenates every thread's local list into shared, emptying the local
+// lists; must be reached by all threads of the team
+void gather(vector<VertexId>& local, vector<VertexId>& shared, size_t& shared_size, vector<size_t>& offsets) {
+    int thread_id = omp_get_thread_num();
+    int num_threads = omp_get_num_threads();
+    offsets[thread_id + 1] = local.size();
+    # pragma omp barrier
+    # pragma omp single
+    {
+        offsets[0] = 0;
+        for (int i = 1; i <= num_threads; i++) offsets[i] += offsets[i-1];
+        shared_size = offsets[num_threads];
+        if (shared.size() < shared_size) shared.resize(shared_size);
+    }
+    copy(local.begin(), local.end(), shared.begin() + offsets[thread_id]);
+    local.clear();
+    # pragma omp barrier
+}
+
+Weight* delta_stepping(Graph& g, VertexId root, Weight delta, EdgeId& relaxations) {
+    Weight* dist = newA(Weight, g.num_nodes);
+    // last bucket whose heavy phase u was queued for
+    size_t* settled_bin = newA(size_t, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        dist[i] = INF;
+        settled_bin[i] = max_bin;
+    }
+    dist[root] = 0;
+
+    // a vertex is queued once per improvement, so the shared frontiers
+    // are grown as needed rather than sized up front
+    vector<VertexId> frontier(1, root);
+    size_t frontier_size = 1;
+    vector<VertexId> settled;
+    size_t settled_size = 0;
+    vector<size_t> offsets(omp_get_max_threads() + 1);
+
+    size_t bin = 0;
+    size_t next_bin = max_bin;
+    EdgeId total_relaxed = 0;
+
+    # pragma omp parallel reduction(+ : total_relaxed)
+    {
+        vector<vector<VertexId>> local_bins(1);
+        vector<VertexId> local_settled;
+
+        while (bin != max_bin) {
+            // light phase: relax the current bucket until nobody refills it
+            while (frontier_size != 0) {
+                # pragma omp for schedule(dynamic, 64)
+                for (size_t i = 0; i < frontier_size; i++) {
+                    VertexId u = frontier[i];
+                    // skip entries whose vertex has since moved to a lower
+                    // distance, they were queued again when it did
+                    if ((size_t) (dist[u] / delta) != bin) continue;
+                    size_t old_bin = settled_bin[u];
+                    if (old_bin != bin && compare_and_swap(&settled_bin[u], old_bin, bin)) local_settled.push_back(u);
+                    total_relaxed += relax_edges(g, u, delta, true, dist, local_bins);
+                }
+
+                // bucket fusion: drain small refills of the current bucket
+                // locally instead of waiting for the other threads
+                while (bin < local_bins.size() && !local_bins[bin].empty() && local_bins[bin].size() < fusion_threshold) {
+                    vector<VertexId> bin_copy;
+                    swap(bin_copy, local_bins[bin]);
+                    for (VertexId u : bin_copy) {
+                        if ((size_t) (dist[u] / delta) != bin) continue;
+                        size_t old_bin = settled_bin[u];
+                        if (old_bin != bin && compare_and_swap(&settled_bin[u], old_bin, bin)) local_settled.push_back(u);
+                        total_relaxed += relax_edges(g, u, delta, true, dist, local_bins);
+                    }
+                }
+
+                if (bin >= local_bins.size()) local_bins.resize(bin + 1);
+                gather(local_bins[bin], frontier, frontier_size, offsets);
+            }
+
+            // heavy phase: the bucket is final, so each heavy edge only
+            // needs relaxing once and can only reach later buckets
+            gather(local_settled, settled, settled_size, offsets);
+            # pragma omp for schedule(dynamic, 64)
+            for (size_t i = 0; i < settled_size; i++) {
+                total_relaxed += relax_edges(g, settled[i], delta, false, dist, local_bins);
+            }
+
+            for (size_t i = bin + 1; i < local_bins.size(); i++) {
+                if (!local_bins[i].empty()) {
+                    # pragma omp critical
+                    next_bin = min(next_bin, i);
+                    break;
+                }
+            }
+            # pragma omp barrier
+            # pragma omp single
+            {
+                bin = next_bin;
+                next_bin = max_bin;
+                if (DEBUG) cout << "Bucket " << bin << endl;
+            }
+            if (bin == max_bin) break;
+            if (bin >= local_bins.size()) local_bins.resize(bin + 1);
+            gather(local_bins[bin], frontier, frontier_size, offsets);
+        }
+    }
+    relaxations = total_relaxed;
+
+    free(settled_bin);
+    return dist;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./delta_stepping <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    const int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+    Weight delta = choose_delta(g);
+    if (DEBUG) cout << "Delta: " << delta << endl;
+
+    double current_time = 0.0;
+    double current_relaxations = 0.0;
+    srand(time(NULL));
+    for (int i = 0; i < num_iters; i++) {
+        VertexId root = rand() % g.num_nodes;
+        EdgeId relaxations;
+        auto time_before = chrono::system_clock::now();
+        Weight* dists = delta_stepping(g, root, delta, relaxations);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        current_relaxations += relaxations;
+        free(dists);
+    }
+
+    // work as edge relaxations per source, then the time on the last line
+    cout << "relaxations: " << current_relaxations / num_iters << endl;
+    cout << current_time / num_iters << endl;
+}
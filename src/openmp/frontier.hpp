@@ -0,0 +1,49 @@
+#ifndef FRONTIER_H_
+#define FRONTIER_H_
+
+#include "sequence.hpp"
+#include "utils.hpp"
+
+// The direction-optimizing switch of bfs, for the traversals that share
+// it: frontier conversions between a vertex list and flags, and Beamer et
+// al.'s rule for when to go bottom-up and back. Include after graph.hpp or
+// graph_weighted.hpp.
+
+// direction-optimizing parameters from Beamer et al., see
+// docs/Direction-Optimizing Breadth-First Search.pdf
+const double bfs_alpha = env_double("BFS_ALPHA", 15.0);
+const double bfs_beta = env_double("BFS_BETA", 18.0);
+
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    # pragma omp parallel for
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        frontier_dense[frontier_sparse[i]] = true;
+    }
+}
+
+void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
+    // pack straight from the flags; filtering frontier_sparse onto itself
+    // races between blocks in the parallel pack
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
+}
+
+// whether the next round goes top-down. frontier_edges and
+// unexplored_edges are m_f and m_u in Beamer et al.: the edges the
+// frontier would scan, and those of the vertices not reached yet
+inline bool next_sparse_mode(bool is_sparse_mode, VertexId num_nodes, VertexId frontier_size, VertexId prev_frontier_size, EdgeId frontier_edges, EdgeId unexplored_edges) {
+    if (is_sparse_mode) {
+        // go bottom-up once checking the frontier's edges costs more
+        // than checking the unexplored vertices' edges
+        return frontier_edges <= unexplored_edges / bfs_alpha;
+    }
+    // go back top-down once the frontier is small and shrinking
+    return frontier_size < num_nodes / bfs_beta && frontier_size < prev_frontier_size;
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <stdlib.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "graph.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Approximate neighborhood function by HyperANF (Boldi, Rosa and Vigna,
+// "HyperANF: Approximating the Neighbourhood Function of Very Large Graphs
+// on a Budget"). Every vertex keeps a HyperLogLog counter of the vertices
+// within t hops of it; a round takes the union of its counter with its
+// in-neighbors' ones, so after round t the counters' estimates sum to
+// N(t), the number of pairs at distance at most t. Unions are register
+// maxima, done eight registers to a word or 32 to an AVX2 vector, and only
+// the in-neighbors whose counter grew in the last round are read. The
+// rounds end once no counter grows, after about the diameter.
+
+// ANF_LOG_REGISTERS=b, from 3 to 16, gives every counter 2^b one-byte
+// registers, for a relative standard error of about 1.04 / 2^(b/2) per
+// counter. The default counter fills a cache line
+const int anf_log_registers = env_double("ANF_LOG_REGISTERS", 6);
+
+// registers hold at most 64 - b + 1 < 128, so the top bit of every byte is
+// free for the broadword comparison
+const uint64_t high_bits = 0x8080808080808080UL;
+
+// every register of a takes the larger of its value and b's. Returns
+// whether any grew
+inline bool union_into(uint8_t* a, const uint8_t* b, int num_registers) {
+    bool grew = false;
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= num_registers; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i larger = _mm256_max_epu8(x, y);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(larger, x)) != -1) {
+            _mm256_storeu_si256((__m256i*) (a + i), larger);
+            grew = true;
+        }
+    }
+#endif
+    for (; i < num_registers; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        // the top bit of a byte of (x | high) - y stays set where x >= y
+        uint64_t x_wins = (((x | high_bits) - y) & high_bits) >> 7;
+        uint64_t larger = (x & (x_wins * 0xFF)) | (y & ~(x_wins * 0xFF));
+        if (larger != x) {
+            memcpy(a + i, &larger, 8);
+            grew = true;
+        }
+    }
+    return grew;
+}
+
+// the counter of the single vertex v
+void init_counter(uint8_t* counter, VertexId v, int log_registers) {
+    int num_registers = 1 << log_registers;
+    memset(counter, 0, num_registers);
+    uint64_t h = ((uint64_t) utils::hash(v) << 32) | utils::hash(v ^ 0x5bd1e995);
+    uint64_t rest = h << log_registers;
+    int rank = rest == 0 ? 64 - log_registers + 1 : __builtin_clzll(rest) + 1;
+    if (rank > 64 - log_registers + 1) rank = 64 - log_registers + 1;
+    counter[h >> (64 - log_registers)] = rank;
+}
+
+// the HyperLogLog estimate of the size of the set, with the linear
+// counting correction for small ones
+double estimate(const uint8_t* counter, int num_registers) {
+    double alpha = num_registers == 16 ? 0.673 : num_registers == 32 ? 0.697 : num_registers == 64 ? 0.709 : 0.7213 / (1 + 1.079 / num_registers);
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < num_registers; i++) {
+        sum += ldexp(1.0, -counter[i]);
+        if (counter[i] == 0) zeros++;
+    }
+    double e = alpha * num_registers * num_registers / sum;
+    if (e <= 2.5 * num_registers && zeros > 0) e = num_registers * log((double) num_registers / zeros);
+    return e;
+}
+
+// one round: the unions are built from the counters as they were before
+// it into counters_next, and copied back for the vertices that grew.
+// Returns how many did
+VertexId anf_round(Graph& g, uint8_t* counters, uint8_t* counters_next, bool* changed, bool* changed_next, int num_registers) {
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        uint8_t* next = counters_next + u * num_registers;
+        bool copied = false, grew = false;
+        VertexId* neighbors = g.in_neighbors(u);
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            VertexId v = neighbors[j];
+            if (!changed[v]) continue;
+            if (!copied) memcpy(next, counters + u * num_registers, num_registers);
+            copied = true;
+            if (union_into(next, counters + v * num_registers, num_registers)) grew = true;
+        }
+        changed_next[u] = grew;
+    }
+
+    VertexId num_changed = 0;
+    # pragma omp parallel for reduction(+:num_changed)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        if (!changed_next[u]) continue;
+        memcpy(counters + u * num_registers, counters_next + u * num_registers, num_registers);
+        num_changed++;
+    }
+    return num_changed;
+}
+
+// the neighborhood function N(0), N(1), ... up to the last hop that adds
+// pairs. harmonic receives every vertex's estimated harmonic centrality,
+// the sum of 1 / d over the vertices at distance d from it
+vector<double> hyperanf(Graph& g, double* harmonic) {
+    int num_registers = 1 << anf_log_registers;
+    uint8_t* counters = newA(uint8_t, g.num_nodes * num_registers);
+    uint8_t* counters_next = newA(uint8_t, g.num_nodes * num_registers);
+    bool* changed = newA(bool, g.num_nodes);
+    bool* changed_next = newA(bool, g.num_nodes);
+    double* estimates = newA(double, g.num_nodes);
+
+    double total = 0;
+    # pragma omp parallel for reduction(+:total)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        init_counter(counters + u * num_registers, u, anf_log_registers);
+        changed[u] = true;
+        estimates[u] = estimate(counters + u * num_registers, num_registers);
+        harmonic[u] = 0;
+        total += estimates[u];
+    }
+    vector<double> neighborhood(1, total);
+
+    VertexId hop = 0;
+    while (hop < g.num_nodes) {
+        hop++;
+        VertexId num_changed = anf_round(g, counters, counters_next, changed, changed_next, num_registers);
+        swap(changed, changed_next);
+        if (num_changed == 0) break;
+
+        total = 0;
+        # pragma omp parallel for reduction(+:total)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            if (changed[u]) {
+                double e = estimate(counters + u * num_registers, num_registers);
+                // the estimates are not monotone, only the counters are
+                if (e > estimates[u]) harmonic[u] += (e - estimates[u]) / hop;
+                estimates[u] = e;
+            }
+            total += estimates[u];
+        }
+        neighborhood.push_back(total);
+        if (DEBUG) cout << "Hop " << hop << " | " << "Changed: " << num_changed << " | N: " << total << endl;
+    }
+
+    free(counters); free(counters_next); free(changed); free(changed_next); free(estimates);
+    return neighborhood;
+}
+
+// the hop by which the given fraction of the pairs at the last hop are
+// reached, interpolated between hops
+double effective_diameter(const vector<double>& neighborhood, double fraction) {
+    double target = fraction * neighborhood.back();
+    size_t t = 0;
+    while (t < neighborhood.size() && neighborhood[t] < target) t++;
+    if (t == 0) return 0;
+    return t - 1 + (target - neighborhood[t - 1]) / (neighborhood[t] - neighborhood[t - 1]);
+}
+
+// mean distance over the pairs of distinct vertices that are connected
+double average_distance(const vector<double>& neighborhood) {
+    double pairs = neighborhood.back() - neighborhood[0];
+    if (pairs <= 0) return 0;
+    double sum = 0;
+    for (size_t t = 1; t < neighborhood.size(); t++) {
+        sum += t * (neighborhood[t] - neighborhood[t - 1]);
+    }
+    return sum / pairs;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./hyperanf <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    // the unions work on whole words of eight registers
+    if (anf_log_registers < 3 || anf_log_registers > 16) {
+        cout << "ANF_LOG_REGISTERS must be between 3 and 16" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    double* harmonic = newA(double, g.num_nodes);
+    vector<double> neighborhood;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        neighborhood = hyperanf(g, harmonic);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+    }
+
+    VertexId most_central = 0;
+    for (VertexId u = 1; u < g.num_nodes; u++) {
+        if (harmonic[u] > harmonic[most_central]) most_central = u;
+    }
+    cout << "neighborhood_function:";
+    for (double n_t : neighborhood) cout << " " << n_t;
+    cout << endl;
+    cout << "effective_diameter: " << effective_diameter(neighborhood, 0.9) << endl;
+    cout << "average_distance: " << average_distance(neighborhood) << endl;
+    if (g.num_nodes > 0) cout << "most_central: " << most_central << " " << harmonic[most_central] << endl;
+    cout << current_time / num_iters << endl;
+    free(harmonic);
+}
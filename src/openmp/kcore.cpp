@@ -0,0 +1,200 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+
+#include "graph.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// k-core decomposition of a symmetric graph by bucketed peeling, after
+// Julienne (Dhulipala et al., "Julienne: A Framework for Parallel Graph
+// Algorithms using Work-efficient Bucketing"). Bucket k is opened with every
+// remaining vertex of degree at most k; peeling it lowers its neighbors'
+// degrees, and those that drop to k join the bucket in the next round. The
+// core number of a vertex is the bucket it was peeled in.
+
+struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+
+// the frontier is pushed from while it is under this fraction of the vertices
+const int threshold_fraction_denom = 20;
+
+// top-down: the frontier decrements the degrees of its remaining neighbors
+VertexId kcore_sparse(Graph& g, EdgeId* degrees, VertexId* core, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId k) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_next[i] = -1;
+    }
+
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId v = frontier[i];
+        VertexId* neighbors = g.out_neighbors(v);
+        for (EdgeId j = 0; j < g.out_degree(v); j++) {
+            VertexId u = neighbors[j];
+            if (core[u] >= 0 || degrees[u] <= k) continue;
+            // racing decrements may take the degree below k, only the one
+            // that crosses into k queues u
+            if (__sync_fetch_and_add(&degrees[u], -1) == k + 1) {
+                core[u] = k;
+                frontier_next[u] = u;
+            }
+        }
+    }
+
+    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+    return frontier_size;
+}
+
+// bottom-up: every remaining vertex counts its neighbors in the frontier
+VertexId kcore_dense(Graph& g, EdgeId* degrees, VertexId* core, bool* frontier, bool* frontier_next, VertexId k) {
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        frontier_next[u] = false;
+        if (core[u] >= 0) continue;
+        VertexId* neighbors = g.in_neighbors(u);
+        EdgeId peeled = 0;
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            if (frontier[neighbors[j]]) peeled++;
+        }
+        degrees[u] -= peeled;
+        if (degrees[u] <= k) frontier_next[u] = true;
+    }
+
+    // core is only set once every vertex has looked at the frontier, as it
+    // doubles as the test for having been peeled
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        if (frontier_next[u]) core[u] = k;
+    }
+    return sequence::sumFlagsSerial(frontier_next, g.num_nodes);
+}
+
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    # pragma omp parallel for
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        frontier_dense[frontier_sparse[i]] = true;
+    }
+}
+
+void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
+}
+
+// opens the next bucket: drops peeled vertices from remaining, and queues
+// every remaining vertex of the lowest degree; returns that degree, or -1
+// once every vertex has been peeled. flags is scratch space of n entries
+VertexId open_bucket(EdgeId* degrees, VertexId* core, VertexId* remaining, VertexId& remaining_size, VertexId* frontier, VertexId& frontier_size, VertexId* flags) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < remaining_size; i++) {
+        flags[i] = core[remaining[i]] < 0 ? remaining[i] : -1;
+    }
+    remaining_size = sequence::filter(flags, remaining, remaining_size, nonNegF());
+    if (remaining_size == 0) return -1;
+
+    EdgeId k = LONG_MAX;
+    # pragma omp parallel for reduction(min : k)
+    for (VertexId i = 0; i < remaining_size; i++) {
+        k = min(k, degrees[remaining[i]]);
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < remaining_size; i++) {
+        VertexId u = remaining[i];
+        flags[i] = degrees[u] <= k ? u : -1;
+    }
+    frontier_size = sequence::filter(flags, frontier, remaining_size, nonNegF());
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        core[frontier[i]] = k;
+    }
+    return k;
+}
+
+VertexId* kcore(Graph& g) {
+    EdgeId* degrees = newA(EdgeId, g.num_nodes);
+    VertexId* core = newA(VertexId, g.num_nodes);
+    VertexId* remaining = newA(VertexId, g.num_nodes);
+
+    VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
+    VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
+    bool* frontier_dense = newA(bool, g.num_nodes);
+    bool* frontier_dense_next = newA(bool, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        degrees[i] = g.out_degree(i);
+        core[i] = -1;
+        remaining[i] = i;
+    }
+    VertexId remaining_size = g.num_nodes;
+
+    VertexId frontier_size = 0;
+    VertexId k;
+    while ((k = open_bucket(degrees, core, remaining, remaining_size, frontier_sparse, frontier_size, frontier_sparse_next)) >= 0) {
+        bool is_sparse_mode = true;
+        VertexId round = 0;
+        while (frontier_size != 0) {
+            round++;
+            bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+            if (DEBUG) cout << "Bucket " << k << " | " << "Round " << round << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+            if (should_be_sparse_mode) {
+                if (!is_sparse_mode) {
+                    dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+                }
+                is_sparse_mode = true;
+                frontier_size = kcore_sparse(g, degrees, core, frontier_sparse, frontier_sparse_next, frontier_size, k);
+            } else {
+                if (is_sparse_mode) {
+                    sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
+                }
+                is_sparse_mode = false;
+                frontier_size = kcore_dense(g, degrees, core, frontier_dense, frontier_dense_next, k);
+                swap(frontier_dense, frontier_dense_next);
+            }
+        }
+    }
+
+    free(degrees); free(remaining);
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next);
+    return core;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./kcore <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    VertexId max_core = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        VertexId* core = kcore(g);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        max_core = g.num_nodes > 0 ? *max_element(core, core + g.num_nodes) : 0;
+        free(core);
+    }
+
+    cout << "max_core: " << max_core << endl;
+    cout << current_time / num_iters << endl;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <stdlib.h>
+
+#include "graph.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Maximal independent set of a symmetric graph in Luby-style rounds with
+// deterministic priorities (Blelloch, Fineman and Shun, "Greedy Sequential
+// Maximal Independent Set and Matching are Parallel on Average"): every
+// vertex gets a priority by hashing its id, an undecided vertex whose
+// priority beats all of its undecided neighbors' joins the set, and the
+// neighbors of the new members drop out. The result is the set the greedy
+// algorithm finds in priority order, independent of the thread count.
+
+typedef char State;
+const State undecided = 0;
+const State in_set = 1;
+const State removed = 2;
+
+struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+
+// hashed priorities, ties broken by id
+inline bool higher_priority(VertexId u, VertexId v) {
+    unsigned int hu = utils::hash(u), hv = utils::hash(v);
+    return hu > hv || (hu == hv && u > v);
+}
+
+// the undecided vertices that beat all of their undecided neighbors join
+// the set; their neighbors are removed. Returns the size of the next
+// frontier, the vertices still undecided
+VertexId mis_round(Graph& g, State* states, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size) {
+    // selection only reads states, the winners are set afterwards
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        bool wins = true;
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u) && wins; j++) {
+            VertexId v = neighbors[j];
+            if (v != u && states[v] == undecided && higher_priority(v, u)) wins = false;
+        }
+        frontier_next[i] = wins ? u : -1;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        if (frontier_next[i] >= 0) states[frontier_next[i]] = in_set;
+    }
+    // a vertex next to several winners may be removed by each of them
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier_next[i];
+        if (u < 0) continue;
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            if (relaxed_load(&states[v]) == undecided) relaxed_store(&states[v], removed);
+        }
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        frontier_next[i] = states[frontier[i]] == undecided ? frontier[i] : -1;
+    }
+    frontier_size = sequence::filter(frontier_next, frontier, frontier_size, nonNegF());
+    return frontier_size;
+}
+
+State* mis(Graph& g) {
+    State* states = newA(State, g.num_nodes);
+    VertexId* frontier = newA(VertexId, g.num_nodes);
+    VertexId* frontier_next = newA(VertexId, g.num_nodes);
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        states[i] = undecided;
+        frontier[i] = i;
+    }
+    VertexId frontier_size = g.num_nodes;
+
+    VertexId round = 0;
+    while (frontier_size != 0) {
+        round++;
+        if (DEBUG) cout << "Round " << round << " | " << "Undecided: " << frontier_size << endl;
+        frontier_size = mis_round(g, states, frontier, frontier_next, frontier_size);
+    }
+
+    free(frontier); free(frontier_next);
+    return states;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./mis <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    VertexId mis_size = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        State* states = mis(g);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        mis_size = 0;
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            if (states[v] == in_set) mis_size++;
+        }
+        free(states);
+    }
+
+    cout << "mis_size: " << mis_size << endl;
+    cout << current_time / num_iters << endl;
+}
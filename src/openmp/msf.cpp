@@ -0,0 +1,190 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+
+#include "graph_weighted.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Minimum spanning forest by Boruvka rounds, with the edges taken as
+// undirected. Every component picks its lightest edge by an atomic min on
+// a key packing (weight, edge id), so ties are broken by id and the picks
+// never form cycles other than two components picking the same edge. The
+// picks hook the components together, pointer jumping contracts them, and
+// edges inside a component are filtered out before the next round.
+
+struct WeightedEdge {
+    VertexId u;
+    VertexId v;
+    Weight w;
+};
+
+// an edge between two components, with the key of its original edge
+struct ComponentEdge {
+    VertexId u;
+    VertexId v;
+    EdgeId key;
+};
+
+struct crossingF{bool operator() (const ComponentEdge& e) {return e.u != e.v;}};
+
+// full path compression, afterwards parent[u] is u's root
+void compress(Graph& g, VertexId* parent) {
+    # pragma omp parallel for schedule(dynamic, 16384)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        while (parent[u] != parent[parent[u]]) {
+            parent[u] = parent[parent[u]];
+        }
+    }
+}
+
+// one round; returns the number of edges it added to the forest. parent
+// maps every vertex to its component on entry and exit
+EdgeId boruvka_round(Graph& g, const WeightedEdge* edges, EdgeId id_mask, ComponentEdge* working, EdgeId working_size, VertexId* parent, EdgeId* min_keys, VertexId* hooks, bool* in_forest) {
+    # pragma omp parallel for
+    for (VertexId c = 0; c < g.num_nodes; c++) {
+        min_keys[c] = LONG_MAX;
+    }
+
+    # pragma omp parallel for
+    for (EdgeId i = 0; i < working_size; i++) {
+        priority_update(&min_keys[working[i].u], working[i].key);
+        priority_update(&min_keys[working[i].v], working[i].key);
+    }
+
+    // every component with an edge hooks onto the one across its lightest
+    # pragma omp parallel for
+    for (VertexId c = 0; c < g.num_nodes; c++) {
+        hooks[c] = -1;
+        if (min_keys[c] == LONG_MAX) continue;
+        const WeightedEdge& e = edges[min_keys[c] & id_mask];
+        hooks[c] = parent[e.u] == c ? parent[e.v] : parent[e.u];
+    }
+
+    // of two components picking the same edge, the smaller one stays a
+    // root and the other one adds the edge
+    EdgeId added = 0;
+    # pragma omp parallel for reduction(+ : added)
+    for (VertexId c = 0; c < g.num_nodes; c++) {
+        if (hooks[c] < 0) continue;
+        if (hooks[hooks[c]] == c && c < hooks[c]) continue;
+        parent[c] = hooks[c];
+        in_forest[min_keys[c] & id_mask] = true;
+        added++;
+    }
+    compress(g, parent);
+    return added;
+}
+
+vector<WeightedEdge> msf(Graph& g) {
+    // the out-edges in CSR order, by id
+    EdgeId* offsets = newA(EdgeId, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        offsets[u] = g.out_degree(u);
+    }
+    EdgeId m = sequence::plusScan(offsets, offsets, g.num_nodes);
+    WeightedEdge* edges = newA(WeightedEdge, m);
+    Weight min_weight = LONG_MAX, max_weight = LONG_MIN;
+    # pragma omp parallel for schedule(dynamic, 1024) reduction(min : min_weight) reduction(max : max_weight)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        VertexId* neighbors = g.out_neighbors(u);
+        Weight* weights = g.out_weights_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            edges[offsets[u] + j] = {u, neighbors[j], weights[j]};
+            min_weight = min(min_weight, weights[j]);
+            max_weight = max(max_weight, weights[j]);
+        }
+    }
+
+    // the weight, shifted to start at 0, goes above the id bits
+    int id_bits = utils::log2Up(m + 1);
+    EdgeId id_mask = (1L << id_bits) - 1;
+    if (m > 0 && (max_weight - min_weight) >= (LONG_MAX >> id_bits)) {
+        cout << "Edge weights span too wide a range to pack with edge ids" << endl;
+        abort();
+    }
+
+    ComponentEdge* working = newA(ComponentEdge, m);
+    ComponentEdge* working_next = newA(ComponentEdge, m);
+    # pragma omp parallel for
+    for (EdgeId i = 0; i < m; i++) {
+        working_next[i] = {edges[i].u, edges[i].v, ((edges[i].w - min_weight) << id_bits) | i};
+    }
+    EdgeId working_size = sequence::filter(working_next, working, m, crossingF());
+
+    VertexId* parent = newA(VertexId, g.num_nodes);
+    EdgeId* min_keys = newA(EdgeId, g.num_nodes);
+    VertexId* hooks = newA(VertexId, g.num_nodes);
+    bool* in_forest = newA(bool, m);
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        parent[i] = i;
+    }
+    # pragma omp parallel for
+    for (EdgeId i = 0; i < m; i++) {
+        in_forest[i] = false;
+    }
+
+    VertexId round = 0;
+    while (working_size != 0) {
+        round++;
+        EdgeId added = boruvka_round(g, edges, id_mask, working, working_size, parent, min_keys, hooks, in_forest);
+
+        // edges now inside a component are dropped
+        # pragma omp parallel for
+        for (EdgeId i = 0; i < working_size; i++) {
+            working[i].u = parent[working[i].u];
+            working[i].v = parent[working[i].v];
+        }
+        working_size = sequence::filter(working, working_next, working_size, crossingF());
+        swap(working, working_next);
+        if (DEBUG) cout << "Round " << round << " | " << "Added: " << added << " | " << "Edges left: " << working_size << endl;
+    }
+
+    vector<WeightedEdge> forest;
+    for (EdgeId i = 0; i < m; i++) {
+        if (in_forest[i]) forest.push_back(edges[i]);
+    }
+    free(offsets); free(edges); free(working); free(working_next);
+    free(parent); free(min_keys); free(hooks); free(in_forest);
+    return forest;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./msf <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    EdgeId forest_edges = 0;
+    Weight forest_weight = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        vector<WeightedEdge> forest = msf(g);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        forest_edges = forest.size();
+        forest_weight = 0;
+        for (const WeightedEdge& e : forest) {
+            forest_weight += e.w;
+        }
+    }
+
+    cout << "msf_edges: " << forest_edges << endl;
+    cout << "msf_weight: " << forest_weight << endl;
+    cout << current_time / num_iters << endl;
+}
@@ -5,32 +5,215 @@
 #include <ctime> 
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <unistd.h>
 
 #include "graph.hpp"
 #include "sequence.hpp"
+#include "semiring.hpp"
 #include "utils.hpp"
 
 using namespace std;
 
 const double damp = 0.85;
 
-double pagerank_dense(Graph& g, double* scores, double* scores_next, double* errors, double* outgoing_contrib, VertexId level) {
+// PR_MODE=tolerance iterates until the L1 change of the scores drops below
+// PR_EPSILON. PR_MODE=delta only keeps vertices whose pending change exceeds
+// PR_DELTA_THRESHOLD of their score active and pushes just those changes.
+// Both give up after PR_MAX_ITERS rounds; otherwise a fixed 10 rounds are run
+const char* PR_MODE = std::getenv("PR_MODE");
+const double pr_epsilon = env_double("PR_EPSILON", 1e-4);
+const double pr_delta_threshold = env_double("PR_DELTA_THRESHOLD", 0.01);
+const int pr_max_iters = env_double("PR_MAX_ITERS", 100);
+
+// PR_KERNEL=blocking runs the dense rounds with propagation blocking;
+// PR_BLOCK_SIZE overrides the number of destinations per bin.
+// PR_KERNEL=mixed keeps the contributions as floats. PR_KERNEL=async
+// updates the scores in place
+const char* PR_KERNEL = std::getenv("PR_KERNEL");
+const VertexId pr_block_size = env_double("PR_BLOCK_SIZE", 0);
+
+// the frontier is pushed from while it is under this fraction of the vertices
+const int threshold_fraction_denom = 20;
+
+struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+
+// a pull round is a product over (+, *) of the contributions, every edge
+// of weight one
+typedef semiring::PlusTimes<double> Sum;
+
+double pagerank_dense(Graph& g, double* scores, double* scores_next, double* errors, double* outgoing_contrib, bool* changed, VertexId level) {
     double base_score = (1.0 - damp) / g.num_nodes;
 
+    // vertices without out-edges have nothing to pass on
     # pragma omp parallel for
     for (VertexId n = 0; n < g.num_nodes; n++)
-        outgoing_contrib[n] = scores[n] / g.out_degree(n);
+        outgoing_contrib[n] = g.out_degree(n) > 0 ? scores[n] / g.out_degree(n) : 0;
 
+    semiring::spmv<Sum>(g, outgoing_contrib, nullptr, scores_next, nullptr, false, changed);
     # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        scores_next[u] = base_score + damp * scores_next[u];
+        errors[u] = fabs(scores_next[u] - scores[u]);
+    }
+
+    double delta = sequence::plusScan(errors, errors, g.num_nodes);
+
+    return delta;
+}
+
+// Mixed precision: the contributions are rounded to float, halving the
+// bytes gathered from random in-neighbors, while the sums and the scores
+// stay double so the rounding does not build up over the rounds.
+
+double pagerank_mixed(Graph& g, double* scores, double* scores_next, double* errors, float* outgoing_contrib) {
+    double base_score = (1.0 - damp) / g.num_nodes;
+
+    # pragma omp parallel for
+    for (VertexId n = 0; n < g.num_nodes; n++)
+        outgoing_contrib[n] = g.out_degree(n) > 0 ? scores[n] / g.out_degree(n) : 0;
+
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        double sum = utils::gather_sum(g.in_neighbors(u), g.in_degree(u), outgoing_contrib);
+        scores_next[u] = base_score + damp * sum;
+        errors[u] = fabs(scores_next[u] - scores[u]);
+    }
+
+    double delta = sequence::plusScan(errors, errors, g.num_nodes);
+
+    return delta;
+}
+
+// Gauss-Seidel: scores and contributions are updated in place, so the
+// vertices after u within a sweep already pull u's new score. Threads read
+// contributions other threads are writing, hence the relaxed atomics.
+// Returns the L1 change of the sweep
+double pagerank_async(Graph& g, double* scores, double* outgoing_contrib) {
+    double base_score = (1.0 - damp) / g.num_nodes;
+    double delta = 0;
+
+    # pragma omp parallel for schedule(dynamic, 1024) reduction(+ : delta)
     for (VertexId u = 0; u < g.num_nodes; u++) {
         double sum = 0;
         VertexId* neighbors = g.in_neighbors(u);
         for (EdgeId j = 0; j < g.in_degree(u); j++) {
-            VertexId v = neighbors[j];
-            sum += outgoing_contrib[v];
+            sum += relaxed_load(&outgoing_contrib[neighbors[j]]);
+        }
+        double score = base_score + damp * sum;
+        delta += fabs(score - scores[u]);
+        scores[u] = score;
+        if (g.out_degree(u) > 0) relaxed_store(&outgoing_contrib[u], score / g.out_degree(u));
+    }
+
+    return delta;
+}
+
+// Propagation blocking (Beamer et al., "Reducing Pagerank Communication via
+// Propagation Blocking"): instead of gathering contributions from random
+// in-neighbors, every edge's contribution is first written out, in source
+// order, to the bin of its destination's block, and each bin is then summed
+// up on its own while its block of destinations stays in cache. The
+// destinations of the bins only depend on the graph, so they are laid out
+// once and a round only streams the contributions through them.
+struct PropagationBins {
+    VertexId block_size;
+    VertexId num_bins;
+    int num_chunks;
+    // sources are split into chunks, each filling its own part of every bin
+    vector<VertexId> chunk_starts;
+    // part of bin b filled by chunk c starts at offsets[b * num_chunks + c]
+    vector<EdgeId> offsets;
+    VertexId* dests;
+    double* values;
+};
+
+// destinations per bin: by default as many scores as fit in half of the L2
+// cache, leaving room for the streamed bins
+VertexId choose_block_size() {
+    if (pr_block_size >= 1) return pr_block_size;
+    long cache_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (cache_size <= 0) cache_size = 256 * 1024;
+    return max(1L, cache_size / 2 / (long) sizeof(double));
+}
+
+PropagationBins make_bins(Graph& g) {
+    PropagationBins bins;
+    bins.block_size = choose_block_size();
+    bins.num_bins = (g.num_nodes + bins.block_size - 1) / bins.block_size;
+    bins.num_chunks = omp_get_max_threads();
+    bins.chunk_starts.resize(bins.num_chunks + 1);
+    for (int c = 0; c <= bins.num_chunks; c++) {
+        bins.chunk_starts[c] = g.num_nodes / bins.num_chunks * c;
+    }
+    bins.chunk_starts[bins.num_chunks] = g.num_nodes;
+
+    vector<EdgeId> counts(bins.num_bins * bins.num_chunks + 1, 0);
+    # pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < bins.num_chunks; c++) {
+        for (VertexId u = bins.chunk_starts[c]; u < bins.chunk_starts[c+1]; u++) {
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                counts[neighbors[j] / bins.block_size * bins.num_chunks + c]++;
+            }
+        }
+    }
+    bins.offsets.resize(counts.size());
+    EdgeId total = sequence::plusScan(counts.data(), bins.offsets.data(), counts.size() - 1);
+    bins.offsets[counts.size() - 1] = total;
+
+    bins.dests = newA(VertexId, total);
+    bins.values = newA(double, total);
+    # pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < bins.num_chunks; c++) {
+        vector<EdgeId> cursors(bins.num_bins);
+        for (VertexId b = 0; b < bins.num_bins; b++) cursors[b] = bins.offsets[b * bins.num_chunks + c];
+        for (VertexId u = bins.chunk_starts[c]; u < bins.chunk_starts[c+1]; u++) {
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                bins.dests[cursors[neighbors[j] / bins.block_size]++] = neighbors[j];
+            }
+        }
+    }
+    return bins;
+}
+
+// the same round as pagerank_dense, with the contributions going through
+// the bins
+double pagerank_blocked(Graph& g, PropagationBins& bins, double* scores, double* scores_next, double* errors) {
+    double base_score = (1.0 - damp) / g.num_nodes;
+
+    // binning: every chunk walks its sources in the order the bins were
+    // laid out in
+    # pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < bins.num_chunks; c++) {
+        vector<EdgeId> cursors(bins.num_bins);
+        for (VertexId b = 0; b < bins.num_bins; b++) cursors[b] = bins.offsets[b * bins.num_chunks + c];
+        for (VertexId u = bins.chunk_starts[c]; u < bins.chunk_starts[c+1]; u++) {
+            if (g.out_degree(u) == 0) continue;
+            double contrib = scores[u] / g.out_degree(u);
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                bins.values[cursors[neighbors[j] / bins.block_size]++] = contrib;
+            }
+        }
+    }
+
+    // accumulation: each bin only touches its own block of scores_next
+    # pragma omp parallel for schedule(dynamic, 1)
+    for (VertexId b = 0; b < bins.num_bins; b++) {
+        VertexId block_start = b * bins.block_size;
+        VertexId block_end = min(block_start + bins.block_size, g.num_nodes);
+        for (VertexId v = block_start; v < block_end; v++) {
+            scores_next[v] = 0;
+        }
+        for (EdgeId i = bins.offsets[b * bins.num_chunks]; i < bins.offsets[(b + 1) * bins.num_chunks]; i++) {
+            scores_next[bins.dests[i]] += bins.values[i];
+        }
+        for (VertexId v = block_start; v < block_end; v++) {
+            scores_next[v] = base_score + damp * scores_next[v];
+            errors[v] = fabs(scores_next[v] - scores[v]);
         }
-        scores_next[u] = base_score + damp * sum;
-        errors[u] = fabs(scores_next[u] - scores[u]);
     }
 
     double delta = sequence::plusScan(errors, errors, g.num_nodes);
@@ -38,10 +221,16 @@ double pagerank_dense(Graph& g, double* scores, double* scores_next, double* err
     return delta;
 }
 
-double* pagerank(Graph& g, int num_iters) {
+// runs num_iters rounds, or fewer once the L1 change of a round is below
+// epsilon; iterations is set to the number of rounds run
+double* pagerank(Graph& g, int num_iters, double epsilon, int& iterations) {
+    // the in-place sweeps need neither a second copy of the scores nor
+    // per-vertex errors
+    bool use_async = PR_KERNEL != nullptr && strcmp(PR_KERNEL, "async") == 0;
     double* scores = newA(double, g.num_nodes);
-    double* scores_next = newA(double, g.num_nodes);
-    double* errors = newA(double, g.num_nodes);
+    double* scores_next = use_async ? nullptr : newA(double, g.num_nodes);
+    double* errors = use_async ? nullptr : newA(double, g.num_nodes);
+    bool* changed = use_async ? nullptr : newA(bool, g.num_nodes);
     double* outgoing_contrib = newA(double, g.num_nodes);
     double error = 0.0;
 
@@ -49,19 +238,184 @@ double* pagerank(Graph& g, int num_iters) {
     # pragma omp parallel for
     for (VertexId i = 0; i < g.num_nodes; i++) {
         scores[i] = init_score; // set init score
+        outgoing_contrib[i] = g.out_degree(i) > 0 ? init_score / g.out_degree(i) : 0;
     }
 
+    bool use_blocking = PR_KERNEL != nullptr && strcmp(PR_KERNEL, "blocking") == 0;
+    PropagationBins bins;
+    if (use_blocking) bins = make_bins(g);
+    bool use_mixed = PR_KERNEL != nullptr && strcmp(PR_KERNEL, "mixed") == 0;
+    float* outgoing_contrib_mixed = use_mixed ? newA(float, g.num_nodes) : nullptr;
+
     VertexId level = 0;
-    const int threshold_fraction_denom = 20; 
 
     while (level < num_iters) {
         level++; 
         // no decision needed, since it's always better
         // to run pagerank as dense
-        error = pagerank_dense(g, scores, scores_next, errors, outgoing_contrib, level);
-        swap(scores, scores_next);
+        if (use_blocking) {
+            error = pagerank_blocked(g, bins, scores, scores_next, errors);
+        } else if (use_mixed) {
+            error = pagerank_mixed(g, scores, scores_next, errors, outgoing_contrib_mixed);
+        } else if (use_async) {
+            error = pagerank_async(g, scores, outgoing_contrib);
+        } else {
+            error = pagerank_dense(g, scores, scores_next, errors, outgoing_contrib, changed, level);
+        }
+        if (!use_async) swap(scores, scores_next);
+        if (DEBUG) cout << "Round " << level << " | " << "Error: " << error << endl;
+        if (error < epsilon) break;
     }
-    free(scores_next); free(errors); free(outgoing_contrib);
+    iterations = level;
+    if (use_blocking) {
+        free(bins.dests); free(bins.values);
+    }
+    if (use_mixed) free(outgoing_contrib_mixed);
+    free(scores_next); free(errors); free(changed); free(outgoing_contrib);
+    return scores;
+}
+
+// Delta-PageRank, as in Ligra's PageRankDelta: the scores are only changed
+// by the residuals of active vertices, and a round pushes damp times the
+// residual of every active vertex to its out-neighbors. Residuals below the
+// threshold are not dropped but keep accumulating until they matter.
+
+// makes the residual of an active vertex part of its score and sets up
+// what it passes on to its out-neighbors
+inline void pagerank_delta_apply(Graph& g, VertexId u, double* scores, double* residuals, double* outgoing_contrib) {
+    outgoing_contrib[u] = g.out_degree(u) > 0 ? damp * residuals[u] / g.out_degree(u) : 0;
+    scores[u] += residuals[u];
+    residuals[u] = 0;
+}
+
+inline bool pagerank_delta_active(VertexId v, double* scores, double* residuals) {
+    return fabs(residuals[v]) > pr_delta_threshold * scores[v];
+}
+
+VertexId pagerank_delta_sparse(Graph& g, double* scores, double* residuals, double* outgoing_contrib, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        pagerank_delta_apply(g, frontier[i], scores, residuals, outgoing_contrib);
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_next[i] = -1;
+    }
+
+    # pragma omp parallel for schedule(dynamic, 64)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            utils::writeAdd(&residuals[v], outgoing_contrib[u]);
+            if (frontier_next[v] < 0) frontier_next[v] = v;
+        }
+    }
+
+    // only vertices that received something can have become active
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (frontier_next[v] >= 0 && !pagerank_delta_active(v, scores, residuals)) frontier_next[v] = -1;
+    }
+    return sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+}
+
+VertexId pagerank_delta_dense(Graph& g, double* scores, double* residuals, double* outgoing_contrib, bool* frontier, bool* frontier_next) {
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        if (frontier[u]) {
+            pagerank_delta_apply(g, u, scores, residuals, outgoing_contrib);
+        } else {
+            outgoing_contrib[u] = 0;
+        }
+    }
+
+    // frontier_next serves as the scratch space of the product
+    semiring::spmv<Sum>(g, outgoing_contrib, nullptr, residuals, nullptr, true, frontier_next);
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        frontier_next[v] = pagerank_delta_active(v, scores, residuals);
+    }
+    return sequence::sumFlagsSerial(frontier_next, g.num_nodes);
+}
+
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    # pragma omp parallel for
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        frontier_dense[frontier_sparse[i]] = true;
+    }
+}
+
+void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontier_sparse) {
+    sequence::packIndex(frontier_sparse, frontier_dense, num_nodes);
+}
+
+double* pagerank_delta(Graph& g, int num_iters, int& iterations) {
+    double* scores = newA(double, g.num_nodes);
+    double* residuals = newA(double, g.num_nodes);
+    double* outgoing_contrib = newA(double, g.num_nodes);
+    VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
+    VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
+    bool* frontier_dense = newA(bool, g.num_nodes);
+    bool* frontier_dense_next = newA(bool, g.num_nodes);
+
+    double init_score = 1.0 / g.num_nodes;
+    double base_score = (1.0 - damp) / g.num_nodes;
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        scores[i] = init_score;
+        outgoing_contrib[i] = g.out_degree(i) > 0 ? init_score / g.out_degree(i) : 0;
+    }
+
+    // the first round is a full one, what it would change the scores by
+    // becomes the starting residual
+    semiring::spmv<Sum>(g, outgoing_contrib, nullptr, residuals, nullptr, false, frontier_dense);
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        residuals[u] = base_score + damp * residuals[u] - scores[u];
+        frontier_sparse_next[u] = pagerank_delta_active(u, scores, residuals) ? u : -1;
+    }
+    VertexId frontier_size = sequence::filter(frontier_sparse_next, frontier_sparse, g.num_nodes, nonNegF());
+
+    bool is_sparse_mode = true;
+    VertexId level = 1;
+    while (frontier_size != 0 && level < num_iters) {
+        level++;
+        bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+        if (DEBUG) cout << "Round " << level << " | " << "Active: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+        if (should_be_sparse_mode) {
+            if (!is_sparse_mode) {
+                dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+            }
+            is_sparse_mode = true;
+            frontier_size = pagerank_delta_sparse(g, scores, residuals, outgoing_contrib, frontier_sparse, frontier_sparse_next, frontier_size);
+        } else {
+            if (is_sparse_mode) {
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
+            }
+            is_sparse_mode = false;
+            frontier_size = pagerank_delta_dense(g, scores, residuals, outgoing_contrib, frontier_dense, frontier_dense_next);
+            swap(frontier_dense, frontier_dense_next);
+        }
+    }
+    iterations = level;
+
+    // fold in what is still pending
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        scores[i] += residuals[i];
+    }
+    free(residuals); free(outgoing_contrib);
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next);
     return scores;
 }
 
@@ -75,6 +429,7 @@ bool verify(const double* scores_compare, const Graph &g, int max_iters) {
         double error = 0;
 
         for (VertexId n = 0; n < g.num_nodes; n++) {
+            if (g.out_degree(n) == 0) continue;
             double outgoing_contrib = scores[n] / g.out_degree(n);
             VertexId* neighbors = g.out_neighbors(n);
             for (EdgeId i = 0; i < g.out_degree(n); i++) {
@@ -114,18 +469,31 @@ int main(int argc, char *argv[]) {
 
     Graph g(argv[1]);
     int num_iters = atoi(argv[2]);
+    bool use_tolerance = PR_MODE != nullptr && strcmp(PR_MODE, "tolerance") == 0;
+    bool use_delta = PR_MODE != nullptr && strcmp(PR_MODE, "delta") == 0;
     double current_time = 0.0;
+    double current_iterations = 0.0;
     
     for (int i = 0; i < num_iters; i++) {
+        int iterations;
         auto time_before = std::chrono::system_clock::now();
-        double* scores = pagerank(g, max_iters);
+        double* scores;
+        if (use_delta) {
+            scores = pagerank_delta(g, pr_max_iters, iterations);
+        } else if (use_tolerance) {
+            scores = pagerank(g, pr_max_iters, pr_epsilon, iterations);
+        } else {
+            scores = pagerank(g, max_iters, 0, iterations);
+        }
 
         auto time_after = std::chrono::system_clock::now();
         std::chrono::duration<double> delta_time = time_after - time_before;
         current_time += delta_time.count();
+        current_iterations += iterations;
         // verify(scores, g, max_iters);
         free(scores);
     }
+    if (use_delta || use_tolerance) std::cout << "iterations: " << current_iterations / num_iters << std::endl;
     std::cout << current_time / num_iters << std::endl;
     
     
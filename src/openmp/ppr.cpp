@@ -0,0 +1,214 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+
+#include "graph.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Approximate personalized PageRank from single seeds by forward push
+// (Andersen, Chung and Lang, "Local Graph Partitioning using PageRank
+// Vectors"), optionally finished with random walks from what is left in
+// the residuals as in FORA (Wang et al., "FORA: Simple and Effective
+// Approximate Single-Source Personalized PageRank"). A query only touches
+// the vertices its push reaches, so its state lives in sparse vectors that
+// every thread reuses across the seeds of a batch.
+
+const double damp = 0.85;
+
+// u is pushed while its residual exceeds PPR_EPSILON times its out-degree
+const double ppr_epsilon = env_double("PPR_EPSILON", 1e-5);
+// seeds per batch, queried concurrently
+const VertexId ppr_seeds = env_double("PPR_SEEDS", 64);
+// PPR_WALKS=w spends about w random walks per query on the leftover
+// residuals; 0 stops at the push
+const double ppr_walks = env_double("PPR_WALKS", 0);
+// vertices kept per query
+const int ppr_top_k = env_double("PPR_TOP_K", 10);
+
+// dense values of which only the touched entries can be non-zero, so
+// clearing costs as much as the last query touched rather than n
+struct SparseVector {
+    vector<double> values;
+    vector<bool> is_touched;
+    vector<VertexId> touched;
+
+    SparseVector(VertexId n) : values(n, 0), is_touched(n, false) {}
+
+    // returns the value before adding
+    double add(VertexId v, double x) {
+        if (!is_touched[v]) {
+            is_touched[v] = true;
+            touched.push_back(v);
+        }
+        double old_value = values[v];
+        values[v] += x;
+        return old_value;
+    }
+
+    void clear() {
+        for (VertexId v : touched) {
+            values[v] = 0;
+            is_touched[v] = false;
+        }
+        touched.clear();
+    }
+};
+
+// per-thread state of a query
+struct PPRState {
+    SparseVector scores;
+    SparseVector residuals;
+    vector<VertexId> queue;
+    unsigned int seed;
+
+    PPRState(VertexId n, unsigned int seed) : scores(n), residuals(n), seed(seed) {}
+};
+
+inline bool ppr_active(Graph& g, VertexId u, double residual) {
+    return residual > ppr_epsilon * max((EdgeId) 1, g.out_degree(u));
+}
+
+// pushes until no residual is above its threshold. Vertices without
+// out-edges send what they pass on back to the seed
+void forward_push(Graph& g, VertexId source, PPRState& state) {
+    SparseVector& r = state.residuals;
+    vector<VertexId>& queue = state.queue;
+    queue.clear();
+    r.add(source, 1.0);
+    queue.push_back(source);
+
+    // queue is a FIFO by head; vertices are queued when they become active
+    size_t head = 0;
+    while (head < queue.size()) {
+        VertexId u = queue[head++];
+        double residual = r.values[u];
+        r.values[u] = 0;
+        state.scores.add(u, (1.0 - damp) * residual);
+
+        double pushed = damp * residual;
+        if (g.out_degree(u) == 0) {
+            if (!ppr_active(g, source, r.add(source, pushed)) && ppr_active(g, source, r.values[source])) queue.push_back(source);
+            continue;
+        }
+        double share = pushed / g.out_degree(u);
+        VertexId* neighbors = g.out_neighbors(u);
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            // queued only when crossing the threshold, it is still in the
+            // queue otherwise
+            if (!ppr_active(g, v, r.add(v, share)) && ppr_active(g, v, r.values[v])) queue.push_back(v);
+        }
+        // long runs drop the consumed prefix of the queue
+        if (head > 4096 && head * 2 > queue.size()) {
+            queue.erase(queue.begin(), queue.begin() + head);
+            head = 0;
+        }
+    }
+}
+
+// a walk from u that stops with probability 1 - damp at every step;
+// returns where it stopped
+VertexId random_walk(Graph& g, VertexId source, VertexId u, unsigned int& seed) {
+    while ((double) rand_r(&seed) / RAND_MAX < damp) {
+        if (g.out_degree(u) == 0) {
+            u = source;
+        } else {
+            u = g.out_neighbors(u)[rand_r(&seed) % g.out_degree(u)];
+        }
+    }
+    return u;
+}
+
+// every leftover residual r is spread over ceil(r * ppr_walks) walks, each
+// adding its share to the score of where it stops
+void residual_walks(Graph& g, VertexId source, PPRState& state) {
+    SparseVector& r = state.residuals;
+    // the walks add to scores, not to residuals, so the touched list of r
+    // stays as it is
+    for (size_t i = 0; i < r.touched.size(); i++) {
+        VertexId u = r.touched[i];
+        double residual = r.values[u];
+        if (residual <= 0) continue;
+        long num_walks = (long) ceil(residual * ppr_walks);
+        for (long w = 0; w < num_walks; w++) {
+            state.scores.add(random_walk(g, source, u, state.seed), residual / num_walks);
+        }
+    }
+}
+
+// the top ppr_top_k vertices of a query, by score
+vector<pair<double, VertexId>> ppr(Graph& g, VertexId source, PPRState& state) {
+    state.scores.clear();
+    state.residuals.clear();
+    forward_push(g, source, state);
+    if (ppr_walks > 0) residual_walks(g, source, state);
+
+    vector<pair<double, VertexId>> top;
+    for (VertexId v : state.scores.touched) {
+        top.push_back(make_pair(state.scores.values[v], v));
+    }
+    size_t k = min((size_t) ppr_top_k, top.size());
+    partial_sort(top.begin(), top.begin() + k, top.end(), greater<pair<double, VertexId>>());
+    top.resize(k);
+    return top;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./ppr <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    srand(time(NULL));
+    vector<PPRState*> states(omp_get_max_threads());
+    for (size_t t = 0; t < states.size(); t++) {
+        states[t] = new PPRState(g.num_nodes, rand());
+    }
+
+    vector<VertexId> seeds(ppr_seeds);
+    vector<vector<pair<double, VertexId>>> results(ppr_seeds);
+    double touched = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        for (VertexId s = 0; s < ppr_seeds; s++) {
+            seeds[s] = rand() % g.num_nodes;
+        }
+        auto time_before = chrono::system_clock::now();
+        # pragma omp parallel for schedule(dynamic, 1) reduction(+ : touched)
+        for (VertexId s = 0; s < ppr_seeds; s++) {
+            PPRState& state = *states[omp_get_thread_num()];
+            results[s] = ppr(g, seeds[s], state);
+            touched += state.residuals.touched.size();
+        }
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        if (DEBUG) {
+            cout << "Seed " << seeds[0] << endl;
+            for (auto& result : results[0]) {
+                cout << result.second << " | " << result.first << endl;
+            }
+        }
+    }
+
+    for (PPRState* state : states) {
+        delete state;
+    }
+
+    cout << "seeds: " << ppr_seeds << endl;
+    cout << "touched_per_query: " << touched / ppr_seeds / num_iters << endl;
+    cout << "queries_per_second: " << ppr_seeds * num_iters / current_time << endl;
+    cout << current_time / num_iters << endl;
+}
@@ -0,0 +1,321 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+
+#include "graph.hpp"
+#include "frontier.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Strongly connected components, following Slota et al., "BFS and
+// Coloring-based Parallel Algorithms for Strongly Connected Components and
+// Related Problems". Vertices without live in- or out-neighbors are trimmed
+// as singletons, the vertices both reachable from and reaching a pivot of
+// high degree are peeled off as the giant SCC, and the rest is finished by
+// coloring: the smallest id reaching a vertex is propagated along out-edges,
+// and every vertex that kept its own color collects its SCC by searching
+// backward among the vertices of that color. Every SCC is labeled with its
+// smallest vertex id.
+
+struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
+
+// trimming stops after this many rounds, coloring handles longer chains
+const int trim_max_rounds = 3;
+
+// singletons: live vertices without a live in- or out-neighbor
+void trim(Graph& g, VertexId* scc, bool* trimmed) {
+    for (int round = 0; round < trim_max_rounds; round++) {
+        VertexId num_trimmed = 0;
+        # pragma omp parallel for schedule(dynamic, 1024) reduction(+ : num_trimmed)
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            trimmed[v] = false;
+            if (scc[v] >= 0) continue;
+            bool has_in = false, has_out = false;
+            VertexId* neighbors = g.in_neighbors(v);
+            for (EdgeId j = 0; j < g.in_degree(v) && !has_in; j++) {
+                if (scc[neighbors[j]] < 0 && neighbors[j] != v) has_in = true;
+            }
+            neighbors = g.out_neighbors(v);
+            for (EdgeId j = 0; j < g.out_degree(v) && !has_out; j++) {
+                if (scc[neighbors[j]] < 0 && neighbors[j] != v) has_out = true;
+            }
+            if (!has_in || !has_out) {
+                trimmed[v] = true;
+                num_trimmed++;
+            }
+        }
+        if (DEBUG) cout << "Trim round " << round << " | " << "Trimmed: " << num_trimmed << endl;
+        if (num_trimmed == 0) break;
+
+        # pragma omp parallel for
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            if (trimmed[v]) scc[v] = v;
+        }
+    }
+}
+
+// the edges v would scan in a search forward or backward
+inline EdgeId search_degree(Graph& g, bool forward, VertexId v) {
+    return forward ? g.out_degree(v) : g.in_degree(v);
+}
+
+// top-down: the frontier marks its live out-neighbors (in-neighbors when
+// searching backward). The new frontier's edges go into frontier_edges
+VertexId reach_sparse(Graph& g, bool forward, const VertexId* scc, bool* visited, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, EdgeId& frontier_edges) {
+    # pragma omp parallel for
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_next[i] = -1;
+    }
+
+    EdgeId edges = 0;
+    # pragma omp parallel for schedule(dynamic, 64) reduction(+ : edges)
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        VertexId* neighbors = forward ? g.out_neighbors(u) : g.in_neighbors(u);
+        EdgeId degree = search_degree(g, forward, u);
+        for (EdgeId j = 0; j < degree; j++) {
+            VertexId v = neighbors[j];
+            if (scc[v] < 0 && !visited[v] && compare_and_swap(&visited[v], false, true)) {
+                frontier_next[v] = v;
+                edges += search_degree(g, forward, v);
+            }
+        }
+    }
+    frontier_edges = edges;
+
+    return sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+}
+
+// bottom-up: every live unvisited vertex looks for a predecessor (a
+// successor when searching backward) in the frontier. The new frontier's
+// edges go into frontier_edges
+VertexId reach_dense(Graph& g, bool forward, const VertexId* scc, bool* visited, bool* frontier, bool* frontier_next, EdgeId& frontier_edges) {
+    EdgeId edges = 0;
+    # pragma omp parallel for schedule(dynamic, 1024) reduction(+ : edges)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        frontier_next[v] = false;
+        if (scc[v] >= 0 || visited[v]) continue;
+        VertexId* neighbors = forward ? g.in_neighbors(v) : g.out_neighbors(v);
+        EdgeId degree = forward ? g.in_degree(v) : g.out_degree(v);
+        for (EdgeId j = 0; j < degree; j++) {
+            if (frontier[neighbors[j]]) {
+                frontier_next[v] = true;
+                edges += search_degree(g, forward, v);
+                break;
+            }
+        }
+    }
+
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (frontier_next[v]) visited[v] = true;
+    }
+    frontier_edges = edges;
+    return sequence::sumFlagsSerial(frontier_next, g.num_nodes);
+}
+
+// marks in visited the live vertices reachable from root, forward along
+// out-edges or backward along in-edges, switching direction as bfs does
+void reach(Graph& g, VertexId root, bool forward, const VertexId* scc, bool* visited) {
+    VertexId* frontier_sparse = newA(VertexId, g.num_nodes);
+    VertexId* frontier_sparse_next = newA(VertexId, g.num_nodes);
+    bool* frontier_dense = newA(bool, g.num_nodes);
+    bool* frontier_dense_next = newA(bool, g.num_nodes);
+
+    // m_u counts the edges of the live vertices only
+    EdgeId unexplored_edges = 0;
+    # pragma omp parallel for reduction(+ : unexplored_edges)
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        visited[i] = false;
+        if (scc[i] < 0) unexplored_edges += search_degree(g, forward, i);
+    }
+    visited[root] = true;
+    frontier_sparse[0] = root;
+    VertexId frontier_size = 1;
+    EdgeId frontier_edges = search_degree(g, forward, root);
+    unexplored_edges -= frontier_edges;
+    VertexId prev_frontier_size = 0;
+    bool is_sparse_mode = true;
+
+    while (frontier_size != 0) {
+        bool should_be_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
+        if (should_be_sparse_mode) {
+            if (!is_sparse_mode) {
+                dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+            }
+            is_sparse_mode = true;
+            frontier_size = reach_sparse(g, forward, scc, visited, frontier_sparse, frontier_sparse_next, frontier_size, frontier_edges);
+        } else {
+            if (is_sparse_mode) {
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
+            }
+            is_sparse_mode = false;
+            frontier_size = reach_dense(g, forward, scc, visited, frontier_dense, frontier_dense_next, frontier_edges);
+            swap(frontier_dense, frontier_dense_next);
+        }
+        unexplored_edges -= frontier_edges;
+    }
+    free(frontier_sparse); free(frontier_sparse_next); free(frontier_dense); free(frontier_dense_next);
+}
+
+// peels off the SCC of the live vertex with the largest in-degree times
+// out-degree, which in most graphs sits in the giant SCC
+void forward_backward(Graph& g, VertexId* scc) {
+    VertexId pivot = -1;
+    EdgeId pivot_score = -1;
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        EdgeId score = g.in_degree(v) * g.out_degree(v);
+        if (scc[v] < 0 && score > pivot_score) {
+            pivot = v;
+            pivot_score = score;
+        }
+    }
+    if (pivot < 0) return;
+
+    bool* forward = newA(bool, g.num_nodes);
+    bool* backward = newA(bool, g.num_nodes);
+    reach(g, pivot, true, scc, forward);
+    reach(g, pivot, false, scc, backward);
+
+    VertexId label = LONG_MAX;
+    # pragma omp parallel for reduction(min : label)
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (forward[v] && backward[v]) label = min(label, v);
+    }
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (forward[v] && backward[v]) scc[v] = label;
+    }
+    if (DEBUG) cout << "Pivot " << pivot << " | " << "SCC " << label << endl;
+    free(forward); free(backward);
+}
+
+// one round of coloring; every live vertex ends up in an SCC or keeps
+// being live for the next round. Returns the number of SCCs found
+VertexId color_round(Graph& g, VertexId* scc, VertexId* colors, VertexId* frontier, VertexId* frontier_next) {
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        colors[v] = v;
+        frontier_next[v] = scc[v] < 0 ? v : -1;
+    }
+    VertexId frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+
+    // push the smallest color reaching every vertex along out-edges
+    while (frontier_size != 0) {
+        # pragma omp parallel for
+        for (VertexId i = 0; i < g.num_nodes; i++) {
+            frontier_next[i] = -1;
+        }
+        # pragma omp parallel for schedule(dynamic, 64)
+        for (VertexId i = 0; i < frontier_size; i++) {
+            VertexId u = frontier[i];
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                VertexId v = neighbors[j];
+                if (scc[v] < 0 && priority_update(&colors[v], colors[u])) frontier_next[v] = v;
+            }
+        }
+        frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+    }
+
+    // no smaller vertex reaches a vertex that kept its own color, so it is
+    // the smallest of its SCC, which is the part of its color that reaches it
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        frontier_next[v] = scc[v] < 0 && colors[v] == v ? v : -1;
+    }
+    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+    VertexId num_roots = frontier_size;
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_size; i++) {
+        scc[frontier[i]] = frontier[i];
+    }
+
+    while (frontier_size != 0) {
+        # pragma omp parallel for
+        for (VertexId i = 0; i < g.num_nodes; i++) {
+            frontier_next[i] = -1;
+        }
+        # pragma omp parallel for schedule(dynamic, 64)
+        for (VertexId i = 0; i < frontier_size; i++) {
+            VertexId v = frontier[i];
+            VertexId* neighbors = g.in_neighbors(v);
+            for (EdgeId j = 0; j < g.in_degree(v); j++) {
+                VertexId u = neighbors[j];
+                if (colors[u] == colors[v] && scc[u] < 0 && compare_and_swap(&scc[u], (VertexId) -1, colors[v])) {
+                    frontier_next[u] = u;
+                }
+            }
+        }
+        frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+    }
+    return num_roots;
+}
+
+VertexId* scc(Graph& g) {
+    VertexId* labels = newA(VertexId, g.num_nodes);
+    bool* trimmed = newA(bool, g.num_nodes);
+    # pragma omp parallel for
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        labels[v] = -1;
+    }
+
+    trim(g, labels, trimmed);
+    forward_backward(g, labels);
+    trim(g, labels, trimmed);
+
+    VertexId* colors = newA(VertexId, g.num_nodes);
+    VertexId* frontier = newA(VertexId, g.num_nodes);
+    VertexId* frontier_next = newA(VertexId, g.num_nodes);
+    VertexId round = 0;
+    while (true) {
+        VertexId live = 0;
+        # pragma omp parallel for reduction(+ : live)
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            if (labels[v] < 0) live++;
+        }
+        if (live == 0) break;
+        VertexId found = color_round(g, labels, colors, frontier, frontier_next);
+        if (DEBUG) cout << "Coloring round " << ++round << " | " << "Live: " << live << " | " << "SCCs: " << found << endl;
+    }
+
+    free(trimmed); free(colors); free(frontier); free(frontier_next);
+    return labels;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./scc <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    VertexId num_sccs = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        VertexId* labels = scc(g);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        num_sccs = 0;
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            if (labels[v] == v) num_sccs++;
+        }
+        free(labels);
+    }
+
+    cout << "sccs: " << num_sccs << endl;
+    cout << current_time / num_iters << endl;
+}
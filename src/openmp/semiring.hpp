@@ -0,0 +1,170 @@
+#ifndef SEMIRING_H_
+#define SEMIRING_H_
+
+#include <vector>
+#include <limits>
+#include <cstring>
+#include "utils.hpp"
+
+// Sparse matrix-vector products over the CSR Graph with the semiring as a
+// template parameter, after the GraphBLAS view of graph algorithms: a round
+// of BFS is a product over (or, and), of Bellman-Ford over (min, +), of
+// PageRank over (+, *) and of label-propagation connectivity over
+// (min, select). spmv pulls a dense vector over the in-edges and spmspv
+// pushes a sparse one, given as a frontier, over the out-edges, so the
+// direction switching of the algorithms is a choice between the two.
+// Include after graph.hpp or graph_weighted.hpp.
+
+namespace semiring {
+
+// A semiring supplies the identity of its addition, the addition, its
+// atomic form add_to, which returns whether it changed *y, and the
+// multiplication of a vector entry by an edge value. saturated(t) says
+// adding anything to t leaves it as it is, which ends a pull early.
+
+// (min, +): shortest paths, with the largest value as infinity
+template <class T>
+struct MinPlus {
+    typedef T value_type;
+    static T zero() { return std::numeric_limits<T>::max(); }
+    static T add(T a, T b) { return a < b ? a : b; }
+    static T multiply(T x, T a) { return x == zero() ? zero() : x + a; }
+    static bool add_to(T* y, T x) { return priority_update(y, x); }
+    static bool saturated(T) { return false; }
+};
+
+// (or, and): reachability
+struct OrAnd {
+    typedef bool value_type;
+    static bool zero() { return false; }
+    static bool add(bool a, bool b) { return a || b; }
+    static bool multiply(bool x, bool a) { return x && a; }
+    static bool add_to(bool* y, bool x) { return x && !*y && compare_and_swap(y, false, true); }
+    static bool saturated(bool t) { return t; }
+};
+
+// (+, *): sums of weighted contributions
+template <class T>
+struct PlusTimes {
+    typedef T value_type;
+    static T zero() { return 0; }
+    static T add(T a, T b) { return a + b; }
+    static T multiply(T x, T a) { return x * a; }
+    static bool add_to(T* y, T x) {
+        if (x == 0) return false;
+        utils::writeAdd(y, x);
+        return true;
+    }
+    static bool saturated(T) { return false; }
+};
+
+// (min, select): the smallest label among the sources, edge values unused
+template <class T>
+struct MinSelect {
+    typedef T value_type;
+    static T zero() { return std::numeric_limits<T>::max(); }
+    static T add(T a, T b) { return a < b ? a : b; }
+    template <class A>
+    static T multiply(T x, A) { return x; }
+    static bool add_to(T* y, T x) { return priority_update(y, x); }
+    static bool saturated(T) { return false; }
+};
+
+// The edge values: the weights of a weighted graph, or one on every edge
+struct EdgeWeights {
+    template <class G>
+    static auto in(G& g, VertexId u) -> decltype(g.in_weights_neighbors(u)) { return g.in_weights_neighbors(u); }
+    template <class G>
+    static auto out(G& g, VertexId u) -> decltype(g.out_weights_neighbors(u)) { return g.out_weights_neighbors(u); }
+    template <class P>
+    static auto at(P values, EdgeId j) -> decltype(values[j]) { return values[j]; }
+};
+
+struct UnitEdges {
+    template <class G>
+    static const int* in(G&, VertexId) { return nullptr; }
+    template <class G>
+    static const int* out(G&, VertexId) { return nullptr; }
+    static int at(const int*, EdgeId) { return 1; }
+};
+
+// y[u] = t, or add(y[u], t) when accumulating, for
+// t = sum over the in-edges (v, u) of multiply(x[v], a_vu), for the u that
+// pass mask. Only the v with x_present[v] count, and nullptr for either
+// means all vertices. x and y may be the same vector: only u's iteration
+// writes y[u], and a source may already hold its new value, which for the
+// min semirings is only better. An accumulating y[u] that is already
+// saturated is skipped. changed[u] records whether y[u] changed; returns
+// how many did. With transpose the product is with the reversed graph,
+// pulling over the out-edges
+template <class SR, class E = UnitEdges, bool transpose = false, class G>
+VertexId spmv(G& g, const typename SR::value_type* x, const bool* x_present, typename SR::value_type* y, const bool* mask, bool accumulate, bool* changed) {
+    typedef typename SR::value_type T;
+    VertexId num_changed = 0;
+    # pragma omp parallel for schedule(dynamic, 1024) reduction(+:num_changed)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        changed[u] = false;
+        if (mask != nullptr && !mask[u]) continue;
+        if (accumulate && SR::saturated(y[u])) continue;
+        VertexId* neighbors = transpose ? g.out_neighbors(u) : g.in_neighbors(u);
+        auto values = transpose ? E::out(g, u) : E::in(g, u);
+        EdgeId degree = transpose ? g.out_degree(u) : g.in_degree(u);
+        T t = SR::zero();
+        for (EdgeId j = 0; j < degree; j++) {
+            VertexId v = neighbors[j];
+            if (x_present != nullptr && !x_present[v]) continue;
+            t = SR::add(t, SR::multiply(relaxed_load(&x[v]), E::at(values, j)));
+            if (SR::saturated(t)) break;
+        }
+        T y_next = accumulate ? SR::add(y[u], t) : t;
+        if (y_next != y[u]) {
+            relaxed_store(&y[u], y_next);
+            changed[u] = true;
+            num_changed++;
+        }
+    }
+    return num_changed;
+}
+
+// y[u] = add(y[u], multiply(x[v], a_vu)) over the out-edges (v, u) of the
+// frontier that pass mask. Pushing always accumulates, with add_to. The u
+// whose y changed go into frontier_next, each once; claimed is all clear
+// on entry and exit. Returns the size of frontier_next. With transpose the
+// product is with the reversed graph, pushing over the in-edges
+template <class SR, class E = UnitEdges, bool transpose = false, class G>
+VertexId spmspv(G& g, const typename SR::value_type* x, const VertexId* frontier, VertexId frontier_size, typename SR::value_type* y, const bool* mask, VertexId* frontier_next, bool* claimed) {
+    VertexId frontier_next_size = 0;
+    # pragma omp parallel
+    {
+        std::vector<VertexId> local;
+        # pragma omp for schedule(dynamic, 64) nowait
+        for (VertexId i = 0; i < frontier_size; i++) {
+            VertexId v = frontier[i];
+            typename SR::value_type x_v = relaxed_load(&x[v]);
+            VertexId* neighbors = transpose ? g.in_neighbors(v) : g.out_neighbors(v);
+            auto values = transpose ? E::in(g, v) : E::out(g, v);
+            EdgeId degree = transpose ? g.in_degree(v) : g.out_degree(v);
+            for (EdgeId j = 0; j < degree; j++) {
+                VertexId u = neighbors[j];
+                if (mask != nullptr && !mask[u]) continue;
+                if (SR::add_to(&y[u], SR::multiply(x_v, E::at(values, j))) && !claimed[u] && compare_and_swap(&claimed[u], false, true)) {
+                    local.push_back(u);
+                }
+            }
+        }
+        if (!local.empty()) {
+            VertexId offset = __sync_fetch_and_add(&frontier_next_size, (VertexId) local.size());
+            memcpy(frontier_next + offset, local.data(), local.size() * sizeof(VertexId));
+        }
+    }
+
+    # pragma omp parallel for
+    for (VertexId i = 0; i < frontier_next_size; i++) {
+        claimed[frontier_next[i]] = false;
+    }
+    return frontier_next_size;
+}
+
+}
+
+#endif
@@ -0,0 +1,329 @@
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <omp.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <stdlib.h>
+
+#include "graph.hpp"
+#include "sequence.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// The k largest eigenpairs of the adjacency matrix A of a symmetric graph,
+// or of N = D^-1/2 A D^-1/2, whose eigenvectors are those of the smallest
+// eigenvalues of the normalized Laplacian I - N: the spectral embedding,
+// with the Fiedler vector second. The solver is LOBPCG (Knyazev, "Toward
+// the Optimal Preconditioned Eigensolver"), with the basis orthonormalized
+// by SVQB (Stathopoulos and Wu, "A Block Orthogonalization Procedure with
+// Constant Synchronization Requirements"). Every iteration multiplies the
+// matrix by a block of up to 2k vectors stored row by row, so the pull
+// loop of pagerank_dense reads every in-edge once for all of them.
+const char* SPECTRAL_MATRIX = std::getenv("SPECTRAL_MATRIX");
+
+// number of eigenpairs
+const int spectral_k = env_double("SPECTRAL_K", 4);
+// done once every residual norm is below SPECTRAL_TOL times the largest
+// eigenvalue in magnitude
+const double spectral_tol = env_double("SPECTRAL_TOL", 1e-6);
+const int spectral_max_iters = env_double("SPECTRAL_MAX_ITERS", 500);
+
+// n vectors of the same width, stored row-major
+struct Block {
+    int width;
+    vector<double> values;
+
+    Block(VertexId n = 0, int width = 0) : width(width), values(n * width, 0) {}
+    double* row(VertexId u) { return values.data() + u * width; }
+    const double* row(VertexId u) const { return values.data() + u * width; }
+};
+
+// Y = M X for M = diag(scale) A diag(scale), A without scaling if scale is
+// nullptr, by pulling over the in-edges as pagerank_dense does
+void spmm(Graph& g, const double* scale, const Block& x, Block& y) {
+    int w = x.width;
+    y = Block(g.num_nodes, w);
+    # pragma omp parallel for schedule(dynamic, 1024)
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        double* sum = y.row(u);
+        VertexId* neighbors = g.in_neighbors(u);
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            VertexId v = neighbors[j];
+            double s = scale != nullptr ? scale[v] : 1;
+            const double* xv = x.row(v);
+            for (int c = 0; c < w; c++) sum[c] += s * xv[c];
+        }
+        if (scale != nullptr) {
+            for (int c = 0; c < w; c++) sum[c] *= scale[u];
+        }
+    }
+}
+
+// the a.width x b.width matrix a^T b
+vector<double> gram(Graph& g, const Block& a, const Block& b) {
+    int wa = a.width, wb = b.width;
+    vector<double> result(wa * wb, 0);
+    # pragma omp parallel
+    {
+        vector<double> local(wa * wb, 0);
+        # pragma omp for
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            const double* au = a.row(u);
+            const double* bu = b.row(u);
+            for (int i = 0; i < wa; i++) {
+                for (int j = 0; j < wb; j++) local[i * wb + j] += au[i] * bu[j];
+            }
+        }
+        # pragma omp critical
+        for (int i = 0; i < wa * wb; i++) result[i] += local[i];
+    }
+    return result;
+}
+
+// a c, for c a a.width x width matrix
+Block combine(Graph& g, const Block& a, const vector<double>& c, int width) {
+    Block result(g.num_nodes, width);
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        const double* au = a.row(u);
+        double* ru = result.row(u);
+        for (int i = 0; i < a.width; i++) {
+            for (int j = 0; j < width; j++) ru[j] += au[i] * c[i * width + j];
+        }
+    }
+    return result;
+}
+
+// eigenvalues of the symmetric m x m matrix a in descending order, and
+// the matching eigenvectors as the columns of v, by cyclic Jacobi
+// rotations. The matrices here are at most 3k wide
+void symmetric_eigen(vector<double> a, int m, vector<double>& eigenvalues, vector<double>& v) {
+    vector<double> rotated(m * m, 0);
+    for (int i = 0; i < m; i++) rotated[i * m + i] = 1;
+
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double off = 0, total = 0;
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) {
+                total += a[i * m + j] * a[i * m + j];
+                if (i != j) off += a[i * m + j] * a[i * m + j];
+            }
+        }
+        if (off <= 1e-30 * total) break;
+
+        for (int p = 0; p < m; p++) {
+            for (int q = p + 1; q < m; q++) {
+                double apq = a[p * m + q];
+                if (apq == 0) continue;
+                // the rotation by t = tan(phi) zeroes a[p][q]
+                double theta = (a[q * m + q] - a[p * m + p]) / (2 * apq);
+                double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                double c = 1 / sqrt(t * t + 1), s = t * c;
+                for (int r = 0; r < m; r++) {
+                    double arp = a[r * m + p], arq = a[r * m + q];
+                    a[r * m + p] = c * arp - s * arq;
+                    a[r * m + q] = s * arp + c * arq;
+                }
+                for (int r = 0; r < m; r++) {
+                    double apr = a[p * m + r], aqr = a[q * m + r];
+                    a[p * m + r] = c * apr - s * aqr;
+                    a[q * m + r] = s * apr + c * aqr;
+                }
+                for (int r = 0; r < m; r++) {
+                    double vrp = rotated[r * m + p], vrq = rotated[r * m + q];
+                    rotated[r * m + p] = c * vrp - s * vrq;
+                    rotated[r * m + q] = s * vrp + c * vrq;
+                }
+            }
+        }
+    }
+
+    vector<int> order(m);
+    for (int i = 0; i < m; i++) order[i] = i;
+    sort(order.begin(), order.end(), [&](int i, int j) { return a[i * m + i] > a[j * m + j]; });
+    eigenvalues.resize(m);
+    v.resize(m * m);
+    for (int j = 0; j < m; j++) {
+        eigenvalues[j] = a[order[j] * m + order[j]];
+        for (int i = 0; i < m; i++) v[i * m + j] = rotated[i * m + order[j]];
+    }
+}
+
+// an orthonormal basis of the span of w, by the eigenvectors of its
+// column-scaled Gram matrix. Directions that are numerically dependent are
+// dropped, so the basis can be narrower than w
+Block svqb(Graph& g, const Block& w) {
+    int m = w.width;
+    vector<double> s = gram(g, w, w);
+    vector<double> norms(m);
+    for (int i = 0; i < m; i++) norms[i] = s[i * m + i] > 0 ? 1 / sqrt(s[i * m + i]) : 0;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) s[i * m + j] *= norms[i] * norms[j];
+    }
+
+    vector<double> eigenvalues, v;
+    symmetric_eigen(s, m, eigenvalues, v);
+    int width = 0;
+    while (width < m && eigenvalues[width] > 1e-10 * max(eigenvalues[0], 1e-300)) width++;
+    vector<double> c(m * width);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < width; j++) c[i * width + j] = norms[i] * v[i * m + j] / sqrt(eigenvalues[j]);
+    }
+    return combine(g, w, c, width);
+}
+
+// w less its projection on the orthonormal x
+void project_out(Graph& g, const Block& x, Block& w) {
+    vector<double> c = gram(g, x, w);
+    Block p = combine(g, x, c, w.width);
+    # pragma omp parallel for
+    for (size_t i = 0; i < w.values.size(); i++) {
+        w.values[i] -= p.values[i];
+    }
+}
+
+// the columns of a and b side by side
+Block concat(Graph& g, const Block& a, const Block& b) {
+    Block result(g.num_nodes, a.width + b.width);
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        copy(a.row(u), a.row(u) + a.width, result.row(u));
+        copy(b.row(u), b.row(u) + b.width, result.row(u) + a.width);
+    }
+    return result;
+}
+
+// the k largest eigenvalues of M, with the eigenvectors in x. Returns the
+// number of iterations
+int lobpcg(Graph& g, const double* scale, int k, Block& x, vector<double>& eigenvalues) {
+    // a random start, the same on every run
+    x = Block(g.num_nodes, k);
+    # pragma omp parallel for
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        for (int c = 0; c < k; c++) x.row(u)[c] = utils::hash(u * k + c) / (double) UINT_MAX - 0.5;
+    }
+    x = svqb(g, x);
+    k = x.width;
+    Block ax, p;
+    spmm(g, scale, x, ax);
+
+    // Rayleigh-Ritz on the span of the start
+    vector<double> ritz_values, c;
+    symmetric_eigen(gram(g, x, ax), k, ritz_values, c);
+    x = combine(g, x, c, k);
+    ax = combine(g, ax, c, k);
+    eigenvalues.assign(ritz_values.begin(), ritz_values.begin() + k);
+
+    int iter = 0;
+    while (iter < spectral_max_iters) {
+        iter++;
+        // residuals r_i = M x_i - lambda_i x_i
+        Block r = ax;
+        # pragma omp parallel for
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            for (int i = 0; i < k; i++) r.row(u)[i] -= eigenvalues[i] * x.row(u)[i];
+        }
+        vector<double> rr = gram(g, r, r);
+        double largest = 0, worst = 0;
+        for (int i = 0; i < k; i++) {
+            largest = max(largest, fabs(eigenvalues[i]));
+            worst = max(worst, sqrt(max(rr[i * k + i], 0.0)));
+        }
+        if (DEBUG) cout << "Iteration " << iter << " | " << "Residual: " << worst << endl;
+        if (worst <= spectral_tol * max(largest, 1e-300)) break;
+
+        // the search directions, orthonormal and orthogonal to x. Twice, as
+        // once leaves them orthogonal only up to the conditioning of the
+        // Gram matrices
+        Block w = p.width > 0 ? concat(g, r, p) : r;
+        for (int pass = 0; pass < 2 && w.width > 0; pass++) {
+            project_out(g, x, w);
+            w = svqb(g, w);
+        }
+        if (w.width == 0) break;
+        Block aw;
+        spmm(g, scale, w, aw);
+
+        // Rayleigh-Ritz on the span of [x w]: the top k eigenvectors of
+        // [x w]^T M [x w] give the new x, and their w part the new p
+        Block s = concat(g, x, w), as = concat(g, ax, aw);
+        int m = s.width;
+        vector<double> h = gram(g, s, as);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < i; j++) h[i * m + j] = h[j * m + i] = (h[i * m + j] + h[j * m + i]) / 2;
+        }
+        symmetric_eigen(h, m, ritz_values, c);
+        vector<double> c_k(m * k), c_w(w.width * k);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < k; j++) {
+                c_k[i * k + j] = c[i * m + j];
+                if (i >= k) c_w[(i - k) * k + j] = c[i * m + j];
+            }
+        }
+        x = combine(g, s, c_k, k);
+        ax = combine(g, as, c_k, k);
+        p = combine(g, w, c_w, k);
+        eigenvalues.assign(ritz_values.begin(), ritz_values.begin() + k);
+    }
+    return iter;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./spectral <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    int num_iters = atoi(argv[2]);
+
+    Graph g(argv[1]);
+
+    bool use_adjacency = SPECTRAL_MATRIX != nullptr && strcmp(SPECTRAL_MATRIX, "adjacency") == 0;
+    int k = min((VertexId) spectral_k, g.num_nodes);
+    // D^-1/2, with isolated vertices left out of N
+    double* scale = nullptr;
+    if (!use_adjacency) {
+        scale = newA(double, g.num_nodes);
+        # pragma omp parallel for
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            scale[u] = g.out_degree(u) > 0 ? 1 / sqrt((double) g.out_degree(u)) : 0;
+        }
+    }
+
+    Block x;
+    vector<double> eigenvalues;
+    int iters = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = chrono::system_clock::now();
+        iters = lobpcg(g, scale, k, x, eigenvalues);
+        auto time_after = chrono::system_clock::now();
+        chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+    }
+
+    // the normalized Laplacian's eigenvalues are one less those of N
+    cout << "eigenvalues:";
+    for (double lambda : eigenvalues) cout << " " << (use_adjacency ? lambda : 1 - lambda);
+    cout << endl;
+    cout << "iterations: " << iters << endl;
+    if (!use_adjacency && x.width >= 2) {
+        // the sign of the Fiedler vector splits the graph in two
+        EdgeId cut = 0;
+        # pragma omp parallel for reduction(+:cut)
+        for (VertexId u = 0; u < g.num_nodes; u++) {
+            VertexId* neighbors = g.out_neighbors(u);
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                if ((x.row(u)[1] < 0) != (x.row(neighbors[j])[1] < 0)) cut++;
+            }
+        }
+        cout << "fiedler_cut: " << cut / 2 << endl;
+    }
+    cout << current_time / num_iters << endl;
+    if (scale != nullptr) free(scale);
+}
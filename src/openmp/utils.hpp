@@ -39,12 +39,22 @@ static int __jj =  mallopt(M_TRIM_THRESHOLD,-1);
 #endif
 
 #include <cstring>
+#include <cstdlib>
 const char* CODE_MODE = std::getenv("CODE_MODE");
 const bool DEBUG = CODE_MODE != nullptr && strcmp(CODE_MODE, "DEBUG") == 0;
 
+// tuning knobs are read from the environment like CODE_MODE
+inline double env_double(const char* name, double default_value) {
+  const char* value = std::getenv(name);
+  return value == nullptr ? default_value : atof(value);
+}
+
 #define newA(__E,__n) (__E*) malloc((__n)*sizeof(__E))
 
 #include <sys/stat.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 inline bool file_exists(const char* name) {
   struct stat buffer;   
@@ -76,6 +86,20 @@ bool priority_update(T* addr, T new_val) {
     return false;
 }
 
+// relaxed atomic accesses, for values other threads update in place while
+// they are being read
+template <class T>
+inline T relaxed_load(const T* addr) {
+    T value;
+    __atomic_load(addr, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+template <class T>
+inline void relaxed_store(T* addr, T value) {
+    __atomic_store(addr, &value, __ATOMIC_RELAXED);
+}
+
 namespace utils {
 
 static void myAssert(int cond, std::string s) {
@@ -108,6 +132,35 @@ static int logUpLong(unsigned long i) {
   return a;
 }
 
+// sum of contrib over the given neighbors, which are 64-bit vertex ids,
+// gathered as floats and added up as doubles. PageRank's mixed-precision
+// kernel uses it to halve the bytes read from random in-neighbors
+inline double gather_sum(const long* neighbors, long degree, const float* contrib) {
+  double sum = 0;
+  long j = 0;
+#if defined(__AVX512F__)
+  __m512d acc = _mm512_setzero_pd();
+  for (; j + 8 <= degree; j += 8) {
+    __m512i idx = _mm512_loadu_si512((const void*) (neighbors + j));
+    acc = _mm512_add_pd(acc, _mm512_cvtps_pd(_mm512_i64gather_ps(idx, contrib, 4)));
+  }
+  sum = _mm512_reduce_add_pd(acc);
+#elif defined(__AVX2__)
+  __m256d acc = _mm256_setzero_pd();
+  for (; j + 4 <= degree; j += 4) {
+    __m256i idx = _mm256_loadu_si256((const __m256i*) (neighbors + j));
+    acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_i64gather_ps(contrib, idx, 4)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; j < degree; j++) {
+    sum += contrib[neighbors[j]];
+  }
+  return sum;
+}
+
 inline unsigned int hash(unsigned int a)
 {
    a = (a+0x7ed55d16) + (a<<12);
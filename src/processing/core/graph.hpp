@@ -39,13 +39,20 @@ class Graph {
 
         VertexId rank_start;
         VertexId rank_end;
+
+        // direction-optimizing parameters from Beamer et al.
+        double alpha = env_double("BFS_ALPHA", 15.0);
+        double beta = env_double("BFS_BETA", 18.0);
+
         Graph(char* path);
+
+        // dense_step returns true once u needs no more of its in-neighbors
         template<typename EdgeData>
         EdgeData* compute(
                 std::function<EdgeData(VertexId)> init_d, 
                 std::function<bool(VertexId)> init_frontier,
                 std::function<void(EdgeData*, EdgeData*, VertexId*, VertexId, VertexId, VertexId)> sparse_step = nullptr,
-                std::function<void(EdgeData*, EdgeData*, bool*, VertexId, VertexId, VertexId)> dense_step = nullptr
+                std::function<bool(EdgeData*, EdgeData*, bool*, VertexId, VertexId, VertexId)> dense_step = nullptr
         ) {
             if (!sparse_step && !dense_step) {
                 cerr << "Must supply at least one of sparse_step and dense_step" << endl;
@@ -75,13 +82,26 @@ class Graph {
             sync_round_sparse(d, frontier_sparse);
             frontier_size = sequence::filter(frontier_sparse, frontier_sparse, num_nodes, nonNegF());
             
+            // m_f and m_u in Beamer et al.: out-edges of the frontier, and
+            // out-edges that no frontier has covered yet
+            EdgeId frontier_edges = sparse_frontier_edges(frontier_sparse, frontier_size);
+            EdgeId unexplored_edges = num_edges - frontier_edges;
+            VertexId prev_frontier_size = 0;
+
             bool is_sparse_mode = true;
             VertexId level = 0;
-            const int threshold_fraction_denom = 20; 
 
             while (frontier_size != 0) {
                 level++;
-                bool should_be_sparse_mode = (frontier_size < (num_nodes / threshold_fraction_denom) && !sparse_step);
+                bool should_be_sparse_mode;
+                if (!dense_step || !sparse_step) {
+                    should_be_sparse_mode = !dense_step;
+                } else if (is_sparse_mode) {
+                    should_be_sparse_mode = frontier_edges <= unexplored_edges / alpha;
+                } else {
+                    should_be_sparse_mode = frontier_size < num_nodes / beta && frontier_size < prev_frontier_size;
+                }
+                prev_frontier_size = frontier_size;
 
                 if (DEBUG && rank_me() == 0) cout << "Round " << level << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
 
@@ -117,6 +137,7 @@ class Graph {
                     delta = time_3 - time_2; 
                     if (DEBUG && rank_me() == 0) cout << "Communication: " << delta.count() << endl;
                     frontier_size = sequence::filter(frontier_sparse_next, frontier_sparse, num_nodes, nonNegF());
+                    frontier_edges = sparse_frontier_edges(frontier_sparse, frontier_size);
                 } else {
                     if (is_sparse_mode) {
                         sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
@@ -139,7 +160,7 @@ class Graph {
 
                             if (!frontier_dense[v]) continue;
 
-                            dense_step(d, d_next, frontier_dense_next, u, v, level);
+                            if (dense_step(d, d_next, frontier_dense_next, u, v, level)) break;
                         }
                     }
                     barrier();
@@ -153,10 +174,13 @@ class Graph {
                     if (DEBUG && rank_me() == 0) cout << "Communication: " << delta.count() << endl;
 
                     frontier_size = sequence::sumFlagsSerial(frontier_dense_next, num_nodes);
+                    frontier_edges = dense_frontier_edges(frontier_dense_next);
                     
                     swap(frontier_dense_next_dist, frontier_dense_dist);
                     swap(frontier_dense_next, frontier_dense);
                 }
+                // vertices may re-enter the frontier outside of BFS
+                unexplored_edges = max(unexplored_edges - frontier_edges, (EdgeId) 0);
 
                 swap(d_next_dist, d_dist);
                 swap(d_next, d);
@@ -171,6 +195,24 @@ class Graph {
 
             return d;
         }
+        // out-degrees are only known to the owner of each vertex
+        EdgeId sparse_frontier_edges(VertexId* frontier_sparse, VertexId frontier_size) {
+            EdgeId local_edges = 0;
+            for (VertexId i = 0; i < frontier_size; i++) {
+                VertexId u = frontier_sparse[i];
+                if (rank_start <= u && u < rank_end) local_edges += out_degree(u);
+            }
+            return reduce_all(local_edges, op_fast_add).wait();
+        }
+
+        EdgeId dense_frontier_edges(bool* frontier_dense) {
+            EdgeId local_edges = 0;
+            for (VertexId u = rank_start; u < rank_end; u++) {
+                if (frontier_dense[u]) local_edges += out_degree(u);
+            }
+            return reduce_all(local_edges, op_fast_add).wait();
+        }
+
         template<typename EdgeData>
         void sync_round_sparse(EdgeData* d_next, VertexId* frontier_next) {
             promise<> p;
@@ -208,6 +250,10 @@ class Graph {
 
         
         void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
+            // clear flags left over from the last dense round
+            for (VertexId i = 0; i < num_nodes; i++) {
+                frontier_dense[i] = false;
+            }
             for (VertexId i = 0; i < frontier_size; i++) {
                 frontier_dense[frontier_sparse[i]] = true;
             }
@@ -306,7 +352,9 @@ Graph::Graph(char *path) {
 }
 
 int Graph::vertex_rank(const VertexId n) {
-    return int(n / (num_nodes / rank_n()));
+    int rank = int(n / (num_nodes / rank_n()));
+    // the last rank also owns the num_nodes % rank_n() leftover vertices
+    return rank < rank_n() ? rank : rank_n() - 1;
 }
 
 EdgeId Graph::in_degree(const VertexId n)  {
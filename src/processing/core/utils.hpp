@@ -39,9 +39,16 @@ static int __jj =  mallopt(M_TRIM_THRESHOLD,-1);
 #endif
 
 #include <cstring>
+#include <cstdlib>
 const char* CODE_MODE = std::getenv("CODE_MODE");
 const bool DEBUG = CODE_MODE != nullptr && strcmp(CODE_MODE, "DEBUG") == 0;
 
+// tuning knobs are read from the environment like CODE_MODE
+inline double env_double(const char* name, double default_value) {
+  const char* value = std::getenv(name);
+  return value == nullptr ? default_value : atof(value);
+}
+
 #define newA(__E,__n) (__E*) malloc((__n)*sizeof(__E))
 
 #include <sys/stat.h>
@@ -27,11 +27,13 @@ Distance* bfs(Graph &g, VertexId root) {
                 frontier_next[v] = v;
             }
         },
-        [&](Distance* dist, Distance* dist_next, bool* frontier_next, VertexId u, VertexId v, VertexId level) {
+        [&](Distance* dist, Distance* dist_next, bool* frontier_next, VertexId u, VertexId v, VertexId level) -> bool {
             if (dist_next[u] == INF && !frontier_next[u]) {
                 dist_next[u] = level;
                 frontier_next[u] = true;
             }
+            // one parent is enough
+            return true;
         }
     );
 }
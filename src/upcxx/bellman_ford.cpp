@@ -11,20 +11,21 @@ using namespace upcxx;
 
 struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
 
-void sync_round_sparse(Graph& g, Weight* dist_next, VertexId* frontier_next) {
-    reduce_all(dist_next, dist_next, g.num_nodes, op_fast_min).wait();
+void sync_round_sparse(Graph& g, Weight* dist, VertexId* frontier_next) {
+    reduce_all(dist, dist, g.num_nodes, op_fast_min).wait();
     reduce_all(frontier_next, frontier_next, g.num_nodes, op_fast_max).wait();
     barrier();
 }
 
-VertexId bf_sparse(Graph& g, global_ptr<Weight> dist_dist, global_ptr<Weight> dist_next_dist, global_ptr<VertexId> frontier_dist, global_ptr<VertexId> frontier_next_dist, VertexId frontier_size, VertexId level) {
+VertexId bf_sparse(Graph& g, global_ptr<Weight> dist_dist, global_ptr<VertexId> frontier_dist, global_ptr<VertexId> frontier_next_dist, VertexId frontier_size, VertexId level) {
     Weight* dist = dist_dist.local();
-    Weight* dist_next = dist_next_dist.local();
     VertexId* frontier = frontier_dist.local();
     VertexId* frontier_next = frontier_next_dist.local();
 
+    // relaxations are monotone min-updates, so dist is lowered in place
+    // and merged with a min-reduction; frontier_next records which
+    // vertices improved this round
     for (VertexId i = 0; i < g.num_nodes; i++) {
-        dist_next[i] = dist[i];
         frontier_next[i] = -1;
     }
 
@@ -36,34 +37,33 @@ VertexId bf_sparse(Graph& g, global_ptr<Weight> dist_dist, global_ptr<Weight> di
         for (EdgeId j = 0; j < g.out_degree(u); j++) {
             VertexId v = neighbors[j];
             Weight relax_dist = dist[u] + weights[j];
-            if (priority_update(&dist_next[v], relax_dist)) {
+            if (priority_update(&dist[v], relax_dist)) {
                 frontier_next[v] = v;
             }
         }
     }
     barrier();
-    sync_round_sparse(g, dist_next, frontier_next);
+    sync_round_sparse(g, dist, frontier_next);
     frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
     return frontier_size; 
 }
 
-void sync_round_dense(Graph& g, Weight* dist_next, bool* frontier_next) {  
+void sync_round_dense(Graph& g, Weight* dist, bool* frontier_next) {  
     for (VertexId i = 0; i < rank_n(); i++) {
-        broadcast(dist_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+        broadcast(dist+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
         broadcast(frontier_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
     }
     barrier();
 }
 
-VertexId bf_dense(Graph& g, global_ptr<Weight> dist_dist, global_ptr<Weight> dist_next_dist, global_ptr<bool> frontier_dist, global_ptr<bool> frontier_next_dist, VertexId level) {
+VertexId bf_dense(Graph& g, global_ptr<Weight> dist_dist, global_ptr<bool> frontier_dist, global_ptr<bool> frontier_next_dist, VertexId level) {
     Weight* dist = dist_dist.local();
-    Weight* dist_next = dist_next_dist.local();
     bool* frontier = frontier_dist.local();
     bool* frontier_next = frontier_next_dist.local();
 
-    for (VertexId u = 0; u < g.num_nodes; u++) {
-        // update next round of dist
-        dist_next[u] = dist[u];
+    // only the local block is written here, the rest of dist and
+    // frontier_next is overwritten by the owners in sync_round_dense
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
         frontier_next[u] = false;
     }
 
@@ -77,22 +77,26 @@ VertexId bf_dense(Graph& g, global_ptr<Weight> dist_dist, global_ptr<Weight> dis
             if (!frontier[v]) continue;
 
             Weight relax_dist = dist[v] + weights[j];
-            if (relax_dist < dist_next[u]) {
-                dist_next[u] = relax_dist; 
+            if (relax_dist < dist[u]) {
+                dist[u] = relax_dist; 
                 compare_and_compare_and_swap(&frontier_next[u]);
             }
         }
 
     }
     barrier();
-    sync_round_dense(g, dist_next, frontier_next);
+    sync_round_dense(g, dist, frontier_next);
     VertexId frontier_size = sequence::sumFlagsSerial(frontier_next, g.num_nodes);
 
     return frontier_size;
 }
 
 
-void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
     for (VertexId i = 0; i < frontier_size; i++) {
         frontier_dense[frontier_sparse[i]] = true;
     }
@@ -112,7 +116,6 @@ void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontie
 Weight* bellman_ford(Graph &g, VertexId root) {
     // https://github.com/sbeamer/gapbs/blob/master/src/pr.cc
     global_ptr<Weight> dist_dist = new_array<Weight>(g.num_nodes); Weight* dist = dist_dist.local();
-    global_ptr<Weight> dist_next_dist = new_array<Weight>(g.num_nodes); Weight* dist_next = dist_next_dist.local();
 
     global_ptr<VertexId> frontier_sparse_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse = frontier_sparse_dist.local();
     global_ptr<VertexId> frontier_sparse_next_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse_next = frontier_sparse_next_dist.local();
@@ -145,27 +148,25 @@ Weight* bellman_ford(Graph &g, VertexId root) {
                 dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
             }
             is_sparse_mode = true;
-            frontier_size = bf_sparse(g, dist_dist, dist_next_dist, frontier_sparse_dist, frontier_sparse_next_dist, frontier_size, level);
+            frontier_size = bf_sparse(g, dist_dist, frontier_sparse_dist, frontier_sparse_next_dist, frontier_size, level);
         } else {
             if (is_sparse_mode) {
-                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
             }
             is_sparse_mode = false;
-            frontier_size = bf_dense(g, dist_dist, dist_next_dist, frontier_dense_dist, frontier_dense_next_dist, level);
+            frontier_size = bf_dense(g, dist_dist, frontier_dense_dist, frontier_dense_next_dist, level);
 
             swap(frontier_dense_next_dist, frontier_dense_dist);
             swap(frontier_dense_next, frontier_dense);
         }
 
-        swap(dist_next_dist, dist_dist);
-        swap(dist_next, dist);
         barrier();
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
         if (DEBUG && rank_me() == 0) cout << "Time: " << delta.count() << endl;
     }
 
-    delete_array(dist_next_dist); delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist); delete_array(frontier_dense_next_dist);
+    delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist); delete_array(frontier_dense_next_dist);
 
     return dist; 
 }
@@ -0,0 +1,355 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+#include "frontier.hpp"
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Betweenness centrality (Brandes, "A Faster Algorithm for Betweenness
+// Centrality") from batches of sources, as in the OpenMP version: every
+// vertex keeps a depth, a shortest path count sigma and a dependency delta
+// per source, vertex-major. depth, sigma and delta are replicated like
+// dist in bfs. A level of the forward phase goes top-down or bottom-up by
+// the switch of bfs: top-down, each rank pushes from its part of the
+// frontier and sends the edges into other ranks' vertices to their owners
+// as one rpc per rank; bottom-up, each rank pulls for the vertices it owns.
+// Only the rows of the vertices that joined the frontier change, so those
+// are all that is shared after a level, and likewise for delta in the
+// backward phase.
+
+typedef int Level;
+
+// BC_SOURCES=k samples k random sources and scales the result by n / k;
+// unset or 0 computes the exact centrality from every vertex
+const VertexId bc_num_sources = env_double("BC_SOURCES", 0);
+// sources searched together
+const int bc_batch = env_double("BC_BATCH", 16);
+
+// shares every rank's block of the vertex-major array values
+template <typename T>
+void sync_blocks(Graph& g, int batch, T* values) {
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(values+g.rank_start_node(i)*batch, g.rank_num_nodes(i)*batch, i).wait();
+    }
+    barrier();
+}
+
+// every rank's part of the frontier, in rank order, which keeps it sorted
+vector<VertexId> share_frontier(const vector<VertexId>& frontier) {
+    vector<VertexId> shared;
+    for (int i = 0; i < rank_n(); i++) {
+        VertexId size = broadcast((VertexId) frontier.size(), i).wait();
+        size_t start = shared.size();
+        shared.resize(start + size);
+        if (rank_me() == i) copy(frontier.begin(), frontier.end(), shared.begin() + start);
+        broadcast(shared.data() + start, size, i).wait();
+    }
+    return shared;
+}
+
+// shares the rows of the vertex-major array values for the vertices of the
+// sorted frontier, each row sent by the owner of its vertex
+template <typename T>
+void sync_rows(Graph& g, int batch, const vector<VertexId>& frontier, T* values) {
+    vector<T> rows(frontier.size() * batch);
+    for (int i = 0; i < rank_n(); i++) {
+        size_t begin = lower_bound(frontier.begin(), frontier.end(), g.rank_start_node(i)) - frontier.begin();
+        size_t end = lower_bound(frontier.begin(), frontier.end(), g.rank_end_node(i)) - frontier.begin();
+        if (rank_me() == i) {
+            for (size_t k = begin; k < end; k++) {
+                copy(values + frontier[k] * batch, values + (frontier[k] + 1) * batch, rows.begin() + k * batch);
+            }
+        }
+        broadcast(rows.data() + begin * batch, (end - begin) * batch, i).wait();
+        if (rank_me() == i) continue;
+        for (size_t k = begin; k < end; k++) {
+            copy(rows.begin() + k * batch, rows.begin() + (k + 1) * batch, values + frontier[k] * batch);
+        }
+    }
+    barrier();
+}
+
+// an out-edge of the frontier into a vertex of another rank
+struct PathEdge {
+    VertexId u;
+    VertexId v;
+};
+
+// the replicated depth and sigma, the target of the top-down pushes
+struct PathBlock {
+    int batch;
+    Level* depth;
+    double* sigma;
+    // owned vertices reached this level, possibly more than once
+    vector<VertexId>* reached;
+
+    // u at depth d adds its path counts to v for the sources that reach v
+    // through it
+    void push(VertexId u, VertexId v, Level d) {
+        const Level* u_depth = depth + u * batch;
+        const double* u_sigma = sigma + u * batch;
+        Level* v_depth = depth + v * batch;
+        double* v_sigma = sigma + v * batch;
+        bool first = false;
+        for (int s = 0; s < batch; s++) {
+            if (u_depth[s] != d) continue;
+            if (v_depth[s] < 0) {
+                v_depth[s] = d + 1;
+                first = true;
+            }
+            if (v_depth[s] == d + 1) v_sigma[s] += u_sigma[s];
+        }
+        if (first) reached->push_back(v);
+    }
+};
+
+// top-down: the owned vertices of the frontier at depth d push to their
+// out-neighbors, the edges into other ranks' vertices aggregated per owner.
+// Returns the owned part of the next frontier
+vector<VertexId> bc_sparse(Graph& g, dist_object<PathBlock>& block, const vector<VertexId>& frontier, Level d) {
+    int batch = block->batch;
+    const Level* depth = block->depth;
+    vector<vector<PathEdge>> edges(rank_n());
+    for (VertexId u : frontier) {
+        if (!(g.rank_start <= u && u < g.rank_end)) continue;
+        const Level* u_depth = depth + u * batch;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            if (g.rank_start <= v && v < g.rank_end) {
+                block->push(u, v, d);
+                continue;
+            }
+            // remote depths are as of the last level, so only send edges
+            // that reach v for some source
+            const Level* v_depth = depth + v * batch;
+            for (int s = 0; s < batch; s++) {
+                if (u_depth[s] == d && v_depth[s] < 0) {
+                    edges[g.vertex_rank(v)].push_back(PathEdge{u, v});
+                    break;
+                }
+            }
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (edges[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<PathBlock>& block, Level d, view<PathEdge> edges) {
+            for (const PathEdge& e : edges) block->push(e.u, e.v, d);
+        }, block, d, make_view(edges[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' pushes into our vertices are in once all are done
+    barrier();
+
+    vector<VertexId> frontier_next;
+    swap(frontier_next, *block->reached);
+    sort(frontier_next.begin(), frontier_next.end());
+    frontier_next.erase(unique(frontier_next.begin(), frontier_next.end()), frontier_next.end());
+    return frontier_next;
+}
+
+// bottom-up: owned vertices some source has not reached yet look for
+// in-neighbors at depth d and add up their path counts; returns the owned
+// part of the next frontier
+vector<VertexId> bc_dense(Graph& g, int batch, Level* depth, double* sigma, Level d) {
+    vector<VertexId> frontier;
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        Level* v_depth = depth + v * batch;
+        double* v_sigma = sigma + v * batch;
+        bool unreached = false;
+        for (int s = 0; s < batch; s++) {
+            if (v_depth[s] < 0) unreached = true;
+        }
+        if (!unreached) continue;
+
+        bool reached = false;
+        VertexId* neighbors = g.in_neighbors(v).local();
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            VertexId u = neighbors[j];
+            const Level* u_depth = depth + u * batch;
+            const double* u_sigma = sigma + u * batch;
+            for (int s = 0; s < batch; s++) {
+                if (u_depth[s] != d) continue;
+                if (v_depth[s] < 0) {
+                    v_depth[s] = d + 1;
+                    reached = true;
+                }
+                if (v_depth[s] == d + 1) v_sigma[s] += u_sigma[s];
+            }
+        }
+        if (reached) frontier.push_back(v);
+    }
+    return frontier;
+}
+
+// the out-edges of frontier go into frontier_edges; returns those of the
+// vertices in it that every source has reached by now. Out-degrees are
+// only known to the owner of each vertex, so both are summed across ranks
+EdgeId finished_edges(Graph& g, int batch, const Level* depth, const vector<VertexId>& frontier, EdgeId& frontier_edges) {
+    EdgeId edges = 0, finished = 0;
+    for (VertexId v : frontier) {
+        if (!(g.rank_start <= v && v < g.rank_end)) continue;
+        edges += g.out_degree(v);
+        const Level* v_depth = depth + v * batch;
+        bool done = true;
+        for (int s = 0; s < batch && done; s++) {
+            if (v_depth[s] < 0) done = false;
+        }
+        if (done) finished += g.out_degree(v);
+    }
+    frontier_edges = reduce_all(edges, op_fast_add).wait();
+    return reduce_all(finished, op_fast_add).wait();
+}
+
+// an owned vertex at depth d pulls the dependencies of its successors at
+// depth d + 1, which were shared the level before
+void bc_backward(Graph& g, int batch, const VertexId* sources, const vector<VertexId>& frontier, const Level* depth, const double* sigma, double* delta, double* bc, Level d) {
+    for (VertexId u : frontier) {
+        if (!(g.rank_start <= u && u < g.rank_end)) continue;
+        const Level* u_depth = depth + u * batch;
+        const double* u_sigma = sigma + u * batch;
+        double* u_delta = delta + u * batch;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            const Level* v_depth = depth + v * batch;
+            const double* v_sigma = sigma + v * batch;
+            const double* v_delta = delta + v * batch;
+            for (int s = 0; s < batch; s++) {
+                if (u_depth[s] == d && v_depth[s] == d + 1) {
+                    u_delta[s] += u_sigma[s] / v_sigma[s] * (1 + v_delta[s]);
+                }
+            }
+        }
+        for (int s = 0; s < batch; s++) {
+            if (u_depth[s] == d && u != sources[s]) bc[u] += u_delta[s];
+        }
+    }
+}
+
+// runs Brandes from the batch of sources and adds their dependencies to
+// the owned part of bc
+void bc_batch_sources(Graph& g, const VertexId* sources, int batch, Level* depth, double* sigma, double* delta, double* bc) {
+    for (VertexId i = 0; i < g.num_nodes * batch; i++) {
+        depth[i] = -1;
+        sigma[i] = 0;
+        delta[i] = 0;
+    }
+    vector<VertexId> reached;
+    dist_object<PathBlock> block(PathBlock{batch, depth, sigma, &reached});
+
+    // levels[d] holds every vertex that is at depth d from some source,
+    // sorted; the sources are known to every rank
+    vector<vector<VertexId>> levels(1);
+    for (int s = 0; s < batch; s++) {
+        depth[sources[s] * batch + s] = 0;
+        sigma[sources[s] * batch + s] = 1;
+        levels[0].push_back(sources[s]);
+    }
+    sort(levels[0].begin(), levels[0].end());
+    levels[0].erase(unique(levels[0].begin(), levels[0].end()), levels[0].end());
+
+    // the direction switch of bfs, with the unexplored edges being those
+    // of vertices that some source has not reached yet, as in ms_bfs
+    EdgeId frontier_edges = 0;
+    EdgeId unexplored_edges = g.num_edges - finished_edges(g, batch, depth, levels[0], frontier_edges);
+    bool is_sparse_mode = true;
+    VertexId prev_frontier_size = 0;
+
+    // forward phase
+    for (Level d = 0; !levels[d].empty(); d++) {
+        VertexId frontier_size = levels[d].size();
+        is_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
+        vector<VertexId> owned = is_sparse_mode ? bc_sparse(g, block, levels[d], d) : bc_dense(g, batch, depth, sigma, d);
+        vector<VertexId> frontier = share_frontier(owned);
+        sync_rows(g, batch, frontier, depth);
+        sync_rows(g, batch, frontier, sigma);
+        unexplored_edges -= finished_edges(g, batch, depth, frontier, frontier_edges);
+        if (DEBUG && rank_me() == 0) cout << "Level " << d + 1 << " | " << "Frontier: " << frontier.size() << " | Sparse? " << is_sparse_mode << endl;
+        levels.push_back(move(frontier));
+    }
+    levels.pop_back();
+
+    // backward phase
+    for (Level d = (Level) levels.size() - 2; d >= 0; d--) {
+        bc_backward(g, batch, sources, levels[d], depth, sigma, delta, bc, d);
+        sync_rows(g, batch, levels[d], delta);
+    }
+}
+
+// centrality from the given sources, scaled by scale
+double* betweenness(Graph& g, const vector<VertexId>& sources, double scale) {
+    int batch = max(1, min(bc_batch, (int) sources.size()));
+    global_ptr<double> bc_dist = new_array<double>(g.num_nodes); double* bc = bc_dist.local();
+    global_ptr<Level> depth_dist = new_array<Level>(g.num_nodes * batch); Level* depth = depth_dist.local();
+    global_ptr<double> sigma_dist = new_array<double>(g.num_nodes * batch); double* sigma = sigma_dist.local();
+    global_ptr<double> delta_dist = new_array<double>(g.num_nodes * batch); double* delta = delta_dist.local();
+
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        bc[i] = 0;
+    }
+
+    for (size_t i = 0; i < sources.size(); i += batch) {
+        // the last batch may be short
+        int size = min((size_t) batch, sources.size() - i);
+        bc_batch_sources(g, sources.data() + i, size, depth, sigma, delta, bc);
+    }
+
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        bc[u] *= scale;
+    }
+    sync_blocks(g, 1, bc);
+    delete_array(depth_dist); delete_array(sigma_dist); delete_array(delta_dist);
+    return bc;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./betweenness <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    srand(time(NULL));
+    bool exact = bc_num_sources <= 0;
+    vector<VertexId> sources(exact ? g.num_nodes : bc_num_sources);
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        for (VertexId s = 0; s < (VertexId) sources.size(); s++) {
+            sources[s] = exact ? s : rand() % g.num_nodes;
+        }
+        broadcast(sources.data(), sources.size(), 0).wait();
+        auto time_before = std::chrono::system_clock::now();
+        double* bc = betweenness(g, sources, exact ? 1.0 : (double) g.num_nodes / sources.size());
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        if (DEBUG && rank_me() == 0) {
+            VertexId top = max_element(bc, bc + g.num_nodes) - bc;
+            cout << "Most central vertex " << top << " | " << bc[top] << endl;
+        }
+        delete_array(to_global_ptr(bc));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "sources: " << sources.size() << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
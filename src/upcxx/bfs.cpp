@@ -3,8 +3,13 @@
 #include <chrono>
 #include <ctime> 
 #include <climits>
+#include <cstdint>
 #include <stdlib.h> 
 #include <time.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "frontier.hpp"
 #include "sequence.hpp"
 
 using namespace upcxx;
@@ -12,23 +17,39 @@ typedef VertexId Distance;
 
 struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
 
-void sync_round_sparse(Graph& g, Distance* dist_next, VertexId* frontier_next) {
+// BFS_MODE=graph500 runs the Graph500 benchmark instead of timing random roots
+const char* BFS_MODE = std::getenv("BFS_MODE");
+const int graph500_num_roots = 64;
+
+// multi-source BFS (Then et al., "The More the Merrier: Efficient
+// Multi-Source Graph Traversal"): every vertex keeps one bit per source in
+// seen/visit/visit_next, so a single edge scan advances all searches of a
+// batch. BFS_MODE=multisource times batches of BFS_BATCH random roots.
+typedef uint64_t SourceMask;
+const int mask_bits = 64;
+const int ms_bfs_max_sources = 512;
+const int ms_bfs_batch = env_double("BFS_BATCH", 64);
+
+void sync_round_sparse(Graph& g, Distance* dist, VertexId* parent, VertexId* frontier_next) {
     promise<> p;
-    reduce_all(dist_next, dist_next, g.num_nodes, op_fast_min, world(), operation_cx::as_promise(p));
+    reduce_all(dist, dist, g.num_nodes, op_fast_min, world(), operation_cx::as_promise(p));
     reduce_all(frontier_next, frontier_next, g.num_nodes, op_fast_max, world(), operation_cx::as_promise(p));
+    // unreached vertices are -1 everywhere, so max keeps one of the parents found
+    if (parent != nullptr) reduce_all(parent, parent, g.num_nodes, op_fast_max, world(), operation_cx::as_promise(p));
     p.finalize().wait();
     barrier();
 }
 
-VertexId bfs_sparse(Graph& g, global_ptr<Distance> dist_dist, global_ptr<Distance> dist_next_dist, global_ptr<VertexId> frontier_dist, global_ptr<VertexId> frontier_next_dist, VertexId frontier_size, VertexId level) {
+// parent is optional and only filled in when non-null
+VertexId bfs_sparse(Graph& g, global_ptr<Distance> dist_dist, VertexId* parent, global_ptr<VertexId> frontier_dist, global_ptr<VertexId> frontier_next_dist, VertexId frontier_size, VertexId level, EdgeId& frontier_edges) {
     auto time_1 = chrono::system_clock::now();
     Distance* dist = dist_dist.local();
-    Distance* dist_next = dist_next_dist.local();
     VertexId* frontier = frontier_dist.local();
     VertexId* frontier_next = frontier_next_dist.local();
     
+    // dist is updated in place and merged with a min-reduction;
+    // frontier_next records which vertices were first reached this round
     for (VertexId i = 0; i < g.num_nodes; i++) {
-        dist_next[i] = dist[i];
         frontier_next[i] = -1;
     }
 
@@ -38,8 +59,9 @@ VertexId bfs_sparse(Graph& g, global_ptr<Distance> dist_dist, global_ptr<Distanc
         VertexId* neighbors = g.out_neighbors(u).local();
         for (EdgeId j = 0; j < g.out_degree(u); j++) {
             VertexId v = neighbors[j];
-            if (dist_next[v] == INF) {
-                dist_next[v] = level;
+            if (dist[v] == INF) {
+                dist[v] = level;
+                if (parent != nullptr) parent[v] = u;
                 frontier_next[v] = v;
             }
         }
@@ -50,38 +72,47 @@ VertexId bfs_sparse(Graph& g, global_ptr<Distance> dist_dist, global_ptr<Distanc
     chrono::duration<double> delta = (time_2 - time_1);
     if (DEBUG && rank_me() == 0) cout << "Calculation: " << delta.count() << endl;
     
-    sync_round_sparse(g, dist_next, frontier_next);
+    sync_round_sparse(g, dist, parent, frontier_next);
     auto time_3 = chrono::system_clock::now();
     delta = time_3 - time_2;
     if (DEBUG && rank_me() == 0) cout << "Communication: " << delta.count() << endl;
     frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+
+    // out-degrees are only known to the owner of each vertex
+    EdgeId local_edges = 0;
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        if (g.rank_start <= u && u < g.rank_end) local_edges += g.out_degree(u);
+    }
+    frontier_edges = reduce_all(local_edges, op_fast_add).wait();
     return frontier_size; 
 }
 
-void sync_round_dense(Graph& g, Distance* dist_next, bool* frontier_next) {  
+void sync_round_dense(Graph& g, Distance* dist, VertexId* parent, bool* frontier_next) {  
     for (VertexId i = 0; i < rank_n(); i++) {
-        broadcast(dist_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+        broadcast(dist+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
         broadcast(frontier_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+        if (parent != nullptr) broadcast(parent+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
     }
     barrier();
 }
 
-VertexId bfs_dense(Graph& g, global_ptr<Distance> dist_dist, global_ptr<Distance> dist_next_dist, global_ptr<bool> frontier_dist, global_ptr<bool> frontier_next_dist, VertexId level) {
+VertexId bfs_dense(Graph& g, global_ptr<Distance> dist_dist, VertexId* parent, global_ptr<bool> frontier_dist, global_ptr<bool> frontier_next_dist, VertexId level, EdgeId& frontier_edges) {
     auto time_1 = chrono::system_clock::now();
     Distance* dist = dist_dist.local();
-    Distance* dist_next = dist_next_dist.local();
     bool* frontier = frontier_dist.local();
     bool* frontier_next = frontier_next_dist.local();
 
-    for (VertexId u = 0; u < g.num_nodes; u++) {
-        // update next round of dist
-        dist_next[u] = dist[u];
+    // only the local block is written here, the rest of dist and
+    // frontier_next is overwritten by the owners in sync_round_dense
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
         frontier_next[u] = false;
     }
 
+    EdgeId local_edges = 0;
     for (VertexId u = g.rank_start; u < g.rank_end; u++) {
         // ignore if distance is set already
-        if (dist_next[u] != INF) continue;
+        if (dist[u] != INF) continue;
         VertexId* neighbors = g.in_neighbors(u).local(); 
 
         for (EdgeId j = 0; j < g.in_degree(u); j++) {
@@ -89,10 +120,12 @@ VertexId bfs_dense(Graph& g, global_ptr<Distance> dist_dist, global_ptr<Distance
 
             if (!frontier[v]) continue;
 
-            if (!frontier_next[u]) {
-                dist_next[u] = level; 
-                frontier_next[u] = true;
-            }
+            dist[u] = level; 
+            if (parent != nullptr) parent[u] = v;
+            frontier_next[u] = true;
+            local_edges += g.out_degree(u);
+            // one parent is enough, skip the rest of u's in-neighbors
+            break;
         }
 
     }
@@ -100,17 +133,22 @@ VertexId bfs_dense(Graph& g, global_ptr<Distance> dist_dist, global_ptr<Distance
     auto time_2 = chrono::system_clock::now();
     chrono::duration<double> delta = (time_2 - time_1);
     if (DEBUG && rank_me() == 0) cout << "Calculation: " << delta.count() << endl;
-    sync_round_dense(g, dist_next, frontier_next);
+    sync_round_dense(g, dist, parent, frontier_next);
     auto time_3 = chrono::system_clock::now();
     delta = time_3 - time_2;
     if (DEBUG && rank_me() == 0) cout << "Communication: " << delta.count() << endl;
     VertexId frontier_size = sequence::sumFlagsSerial(frontier_next, g.num_nodes);
+    frontier_edges = reduce_all(local_edges, op_fast_add).wait();
 
     return frontier_size;
 }
 
 
-void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
     for (VertexId i = 0; i < frontier_size; i++) {
         frontier_dense[frontier_sparse[i]] = true;
     }
@@ -127,10 +165,9 @@ void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontie
     sequence::filter(frontier_sparse, frontier_sparse, num_nodes, nonNegF());
 }
 
-Distance* bfs(Graph &g, VertexId root) {
+Distance* bfs(Graph &g, VertexId root, VertexId* parent = nullptr) {
     // https://github.com/sbeamer/gapbs/blob/master/src/pr.cc
     global_ptr<Distance> dist_dist = new_array<Distance>(g.num_nodes); Distance* dist = dist_dist.local();
-    global_ptr<Distance> dist_next_dist = new_array<Distance>(g.num_nodes); Distance* dist_next = dist_next_dist.local();
 
     global_ptr<VertexId> frontier_sparse_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse = frontier_sparse_dist.local();
     global_ptr<VertexId> frontier_sparse_next_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse_next = frontier_sparse_next_dist.local();
@@ -140,6 +177,7 @@ Distance* bfs(Graph &g, VertexId root) {
 
     for (VertexId i = 0; i < g.num_nodes; i++) {
         dist[i] = INF;
+        if (parent != nullptr) parent[i] = -1;
     }
 
     bool is_sparse_mode = true;
@@ -147,13 +185,22 @@ Distance* bfs(Graph &g, VertexId root) {
     frontier_sparse[0] = root;
     VertexId frontier_size = 1;
     dist[root] = 0; // initialize everyone to INF except root
+    if (parent != nullptr) parent[root] = root;
+
+    // m_f and m_u in Beamer et al.: out-edges of the frontier, and
+    // out-edges of vertices that have not been reached yet
+    EdgeId frontier_edges = 0;
+    if (g.rank_start <= root && root < g.rank_end) frontier_edges = g.out_degree(root);
+    frontier_edges = reduce_all(frontier_edges, op_fast_add).wait();
+    EdgeId unexplored_edges = g.num_edges - frontier_edges;
+    VertexId prev_frontier_size = 0;
 
     VertexId level = 0;
-    const int threshold_fraction_denom = 20;
 
     while (frontier_size != 0) {
         level++; 
-        bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+        bool should_be_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
 
         if (DEBUG && rank_me() == 0) cout << "Round " << level << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
         auto time_before = chrono::system_clock::now();
@@ -163,65 +210,400 @@ Distance* bfs(Graph &g, VertexId root) {
                 dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
             }
             is_sparse_mode = true;
-            frontier_size = bfs_sparse(g, dist_dist, dist_next_dist, frontier_sparse_dist, frontier_sparse_next_dist, frontier_size, level);
+            frontier_size = bfs_sparse(g, dist_dist, parent, frontier_sparse_dist, frontier_sparse_next_dist, frontier_size, level, frontier_edges);
         } else {
             if (is_sparse_mode) {
-                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
             }
             is_sparse_mode = false;
-            frontier_size = bfs_dense(g, dist_dist, dist_next_dist, frontier_dense_dist, frontier_dense_next_dist, level);
+            frontier_size = bfs_dense(g, dist_dist, parent, frontier_dense_dist, frontier_dense_next_dist, level, frontier_edges);
 
             swap(frontier_dense_next_dist, frontier_dense_dist);
             swap(frontier_dense_next, frontier_dense);
         }
+        unexplored_edges -= frontier_edges;
 
-        swap(dist_next_dist, dist_dist);
-        swap(dist_next, dist);
         barrier();
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
         if (DEBUG && rank_me() == 0) cout << "Time: " << delta.count() << endl;
     }
 
-    delete_array(dist_next_dist); delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist); delete_array(frontier_dense_next_dist);
+    delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist); delete_array(frontier_dense_next_dist);
 
     return dist; 
 }
 
-/*
-bool verify(Graph& g, int root, vector<int> dist_in) {
-    vector<int> dist(g.num_nodes);
-    if (dist.size() != dist_in.size())
-        return false;
-    for (int i = 0; i < g.num_nodes; i++)
-        dist[i] = INF; // set INF
-    dist[root] = 0;
-    int level = 1;
-    vector<int> frontier, next_frontier;
-    frontier.push_back(root);
-    while (frontier.size() != 0) {
-        for (int i = 0; i < frontier.size(); i++) {
-            int u = frontier[i];
-            vector<int> neighbors = g.out_neighbors(u);
-            for (int j = 0; j < g.out_degree(u); j++) {
-                int v = neighbors[j];
-                if (dist[v] == INF) {
-                    next_frontier.push_back(v);
-                    dist[v] = level;
-                }
+// marks the sources in next as having seen v and records their distance to
+// v; returns whether all sources have seen v now. seen and dist are
+// replicated, so every rank applies this to every vertex of the frontier
+bool ms_bfs_visit(Graph& g, int words, VertexId v, SourceMask* seen, const SourceMask* next, Distance* dist, VertexId level) {
+    bool finished = true;
+    for (int w = 0; w < words; w++) {
+        SourceMask bits = next[w];
+        seen[v*words + w] |= bits;
+        if (~seen[v*words + w] != 0) finished = false;
+        while (bits != 0) {
+            int s = w * mask_bits + __builtin_ctzll(bits);
+            dist[(EdgeId) s * g.num_nodes + v] = level;
+            bits &= bits - 1;
+        }
+    }
+    return finished;
+}
+
+// visits the new frontier; out-degrees are only known to the owner of each
+// vertex, so the edge counts are summed across ranks
+void ms_bfs_visit_frontier(Graph& g, int words, Distance* dist, SourceMask* seen, SourceMask* visit_next, VertexId* frontier, VertexId frontier_size, VertexId level, EdgeId& frontier_edges, EdgeId& finished_edges) {
+    EdgeId local_edges = 0, local_finished = 0;
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId v = frontier[i];
+        bool finished = ms_bfs_visit(g, words, v, seen, visit_next + v*words, dist, level);
+        if (!(g.rank_start <= v && v < g.rank_end)) continue;
+        local_edges += g.out_degree(v);
+        if (finished) local_finished += g.out_degree(v);
+    }
+    frontier_edges = reduce_all(local_edges, op_fast_add).wait();
+    finished_edges = reduce_all(local_finished, op_fast_add).wait();
+}
+
+void sync_round_ms_sparse(Graph& g, int words, SourceMask* visit_next, VertexId* frontier_next) {
+    promise<> p;
+    reduce_all(visit_next, visit_next, g.num_nodes * words, op_fast_bit_or, world(), operation_cx::as_promise(p));
+    reduce_all(frontier_next, frontier_next, g.num_nodes, op_fast_max, world(), operation_cx::as_promise(p));
+    p.finalize().wait();
+    barrier();
+}
+
+// visit_next must be all zero on entry; visit is cleared for the frontier
+// on the way out so the two can be swapped
+VertexId ms_bfs_sparse(Graph& g, int words, Distance* dist, SourceMask* seen, SourceMask* visit, SourceMask* visit_next, VertexId* frontier, VertexId* frontier_next, VertexId frontier_size, VertexId level, EdgeId& frontier_edges, EdgeId& finished_edges) {
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_next[i] = -1;
+    }
+
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        if (!(g.rank_start <= u && u < g.rank_end)) continue;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            bool reached = false;
+            for (int w = 0; w < words; w++) {
+                SourceMask next = visit[u*words + w] & ~seen[v*words + w];
+                if (next == 0) continue;
+                reached = true;
+                visit_next[v*words + w] |= next;
+            }
+            if (reached) frontier_next[v] = v;
+        }
+    }
+    barrier();
+
+    sync_round_ms_sparse(g, words, visit_next, frontier_next);
+
+    for (VertexId i = 0; i < frontier_size; i++) {
+        VertexId u = frontier[i];
+        for (int w = 0; w < words; w++) visit[u*words + w] = 0;
+    }
+
+    frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
+    ms_bfs_visit_frontier(g, words, dist, seen, visit_next, frontier, frontier_size, level, frontier_edges, finished_edges);
+    return frontier_size;
+}
+
+void sync_round_ms_dense(Graph& g, int words, SourceMask* visit_next) {
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(visit_next+g.rank_start_node(i)*words, g.rank_num_nodes(i)*words, i).wait();
+    }
+    barrier();
+}
+
+// each rank gathers visit_next for its own block, then every rank visits
+// the whole frontier; frontier_next flags it for converting back to a
+// sparse frontier
+VertexId ms_bfs_dense(Graph& g, int words, Distance* dist, SourceMask* seen, SourceMask* visit, SourceMask* visit_next, VertexId* frontier, bool* frontier_next, VertexId level, EdgeId& frontier_edges, EdgeId& finished_edges) {
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        SourceMask* next = visit_next + v*words;
+        SourceMask* v_seen = seen + v*words;
+        bool active = false;
+        for (int w = 0; w < words; w++) {
+            next[w] = 0;
+            if (~v_seen[w] != 0) active = true;
+        }
+        // ignore if every source has seen v already
+        if (!active) continue;
+
+        VertexId* neighbors = g.in_neighbors(v).local();
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            VertexId u = neighbors[j];
+            bool done = true;
+            for (int w = 0; w < words; w++) {
+                next[w] |= visit[u*words + w] & ~v_seen[w];
+                if (next[w] != ~v_seen[w]) done = false;
             }
+            // every source missing v reaches it this round, skip the rest
+            if (done) break;
         }
-        frontier = next_frontier; 
-        next_frontier.clear();
-        level += 1; 
     }
-    for (int i = 0; i < dist.size(); i++) {
-        if (dist[i] != dist_in[i]) {
-            return false;
+    barrier();
+
+    sync_round_ms_dense(g, words, visit_next);
+
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        frontier_next[v] = false;
+        for (int w = 0; w < words; w++) {
+            if (visit_next[v*words + w] != 0) frontier_next[v] = true;
+        }
+    }
+    for (VertexId i = 0; i < g.num_nodes * words; i++) {
+        visit[i] = 0;
+    }
+
+    // the sparse list is only used to visit the frontier here
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier[i] = frontier_next[i] ? i : -1;
+    }
+    VertexId frontier_size = sequence::filter(frontier, frontier, g.num_nodes, nonNegF());
+    ms_bfs_visit_frontier(g, words, dist, seen, visit_next, frontier, frontier_size, level, frontier_edges, finished_edges);
+    return frontier_size;
+}
+
+// runs a BFS from each of up to ms_bfs_max_sources sources at once; the
+// distance from sources[s] to v is returned at s * g.num_nodes + v
+Distance* ms_bfs(Graph& g, const VertexId* sources, int num_sources) {
+    int words = (num_sources + mask_bits - 1) / mask_bits;
+    global_ptr<Distance> dist_dist = new_array<Distance>((EdgeId) num_sources * g.num_nodes); Distance* dist = dist_dist.local();
+    global_ptr<SourceMask> seen_dist = new_array<SourceMask>(g.num_nodes * words); SourceMask* seen = seen_dist.local();
+    global_ptr<SourceMask> visit_dist = new_array<SourceMask>(g.num_nodes * words); SourceMask* visit = visit_dist.local();
+    global_ptr<SourceMask> visit_next_dist = new_array<SourceMask>(g.num_nodes * words); SourceMask* visit_next = visit_next_dist.local();
+
+    global_ptr<VertexId> frontier_sparse_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse = frontier_sparse_dist.local();
+    global_ptr<VertexId> frontier_sparse_next_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse_next = frontier_sparse_next_dist.local();
+    global_ptr<bool> frontier_dense_dist = new_array<bool>(g.num_nodes); bool* frontier_dense = frontier_dense_dist.local();
+
+    for (EdgeId i = 0; i < (EdgeId) num_sources * g.num_nodes; i++) {
+        dist[i] = INF;
+    }
+    // bits past num_sources start out seen, so a vertex is finished
+    // exactly when all of its seen bits are set
+    SourceMask unused = num_sources % mask_bits == 0 ? 0 : ~(SourceMask) 0 << (num_sources % mask_bits);
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        for (int w = 0; w < words; w++) {
+            seen[v*words + w] = w == words - 1 ? unused : 0;
+            visit[v*words + w] = 0;
+            visit_next[v*words + w] = 0;
         }
     }
-    return true;
-}*/
+
+    VertexId frontier_size = 0;
+    for (int s = 0; s < num_sources; s++) {
+        VertexId root = sources[s];
+        bool is_new = true;
+        for (int w = 0; w < words; w++) {
+            if (visit[root*words + w] != 0) is_new = false;
+        }
+        if (is_new) frontier_sparse[frontier_size++] = root;
+        visit[root*words + s / mask_bits] |= (SourceMask) 1 << (s % mask_bits);
+    }
+
+    bool is_sparse_mode = true;
+
+    // same direction-optimizing switch as bfs(), with the unexplored edges
+    // being those of vertices that some source has not seen yet
+    EdgeId frontier_edges, finished_edges;
+    ms_bfs_visit_frontier(g, words, dist, seen, visit, frontier_sparse, frontier_size, 0, frontier_edges, finished_edges);
+    EdgeId unexplored_edges = g.num_edges - finished_edges;
+    VertexId prev_frontier_size = 0;
+
+    VertexId level = 0;
+
+    while (frontier_size != 0) {
+        level++;
+        bool should_be_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
+
+        if (DEBUG && rank_me() == 0) cout << "Round " << level << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+        // the dense kernel reads visit directly, so only the way back to
+        // a sparse frontier needs a conversion
+        if (should_be_sparse_mode) {
+            if (!is_sparse_mode) {
+                dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
+            }
+            is_sparse_mode = true;
+            frontier_size = ms_bfs_sparse(g, words, dist, seen, visit, visit_next, frontier_sparse, frontier_sparse_next, frontier_size, level, frontier_edges, finished_edges);
+        } else {
+            is_sparse_mode = false;
+            frontier_size = ms_bfs_dense(g, words, dist, seen, visit, visit_next, frontier_sparse, frontier_dense, level, frontier_edges, finished_edges);
+        }
+        swap(visit, visit_next);
+        unexplored_edges -= finished_edges;
+    }
+    delete_array(seen_dist); delete_array(visit_dist); delete_array(visit_next_dist);
+    delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist);
+    return dist;
+}
+
+// picks up to num_roots distinct roots with nonzero out-degree
+vector<VertexId> sample_roots(Graph& g, int num_roots) {
+    // every rank needs every degree so that they agree on the candidates
+    global_ptr<bool> has_edges_dist = new_array<bool>(g.num_nodes); bool* has_edges = has_edges_dist.local();
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        has_edges[v] = g.out_degree(v) > 0;
+    }
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(has_edges+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+
+    vector<VertexId> candidates;
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (has_edges[v]) candidates.push_back(v);
+    }
+    delete_array(has_edges_dist);
+
+    VertexId k = min((VertexId) num_roots, (VertexId) candidates.size());
+    if (rank_me() == 0) {
+        // partial Fisher-Yates shuffle
+        for (VertexId i = 0; i < k; i++) {
+            VertexId j = i + rand() % (candidates.size() - i);
+            swap(candidates[i], candidates[j]);
+        }
+    }
+    broadcast(candidates.data(), k, 0).wait();
+    candidates.resize(k);
+    return candidates;
+}
+
+// The five Graph500 validation rules, with edges followed from source to
+// destination only since the graph may be directed:
+// 1. the parent pointers form a tree rooted at root with no cycles
+// 2. tree edges connect vertices whose levels differ by exactly one
+// 3. an edge from a reached vertex leads to a reached vertex at most
+//    one level further
+// 4. the tree spans exactly the vertices reachable from root
+// 5. every tree edge is an edge of the graph
+// Each rank checks the vertices it owns against the replicated dist and parent.
+bool validate(Graph& g, VertexId root, Distance* dist, VertexId* parent) {
+    bool valid = parent[root] == root && dist[root] == 0;
+
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        bool reached = dist[v] != INF;
+        // rule 4, together with rule 3 closing the tree under out-edges
+        if (reached != (parent[v] != -1)) {
+            valid = false;
+            continue;
+        }
+        if (!reached) continue;
+
+        // rule 3
+        VertexId* neighbors = g.out_neighbors(v).local();
+        for (EdgeId j = 0; j < g.out_degree(v); j++) {
+            VertexId w = neighbors[j];
+            if (dist[w] == INF || dist[w] > dist[v] + 1) valid = false;
+        }
+        if (v == root) continue;
+
+        // rules 1 and 2: only the root is at level 0 and levels drop by
+        // one along every parent pointer, so every chain ends at root
+        VertexId p = parent[v];
+        if (dist[v] == 0 || p < 0 || p >= g.num_nodes || dist[p] == INF || dist[v] != dist[p] + 1) {
+            valid = false;
+            continue;
+        }
+
+        // rule 5
+        bool has_edge = false;
+        neighbors = g.in_neighbors(v).local();
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            if (neighbors[j] == p) {
+                has_edge = true;
+                break;
+            }
+        }
+        if (!has_edge) valid = false;
+    }
+    return reduce_all((int) valid, op_fast_min).wait() == 1;
+}
+
+// edges in the traversed component, the numerator of TEPS
+EdgeId traversed_edges(Graph& g, Distance* dist) {
+    EdgeId local_edges = 0;
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        if (dist[v] != INF) local_edges += g.out_degree(v);
+    }
+    return reduce_all(local_edges, op_fast_add).wait();
+}
+
+// linearly interpolated quantile of sorted data
+double quantile(const vector<double>& sorted, double q) {
+    double pos = q * (sorted.size() - 1);
+    size_t k = (size_t) pos;
+    if (k + 1 >= sorted.size()) return sorted.back();
+    return sorted[k] + (pos - k) * (sorted[k+1] - sorted[k]);
+}
+
+void print_statistics(const string& name, vector<double> data, bool harmonic) {
+    sort(data.begin(), data.end());
+    double n = data.size();
+    double mean = 0, variance = 0;
+    for (double x : data) mean += x / n;
+    for (double x : data) variance += (x - mean) * (x - mean) / max(n - 1, 1.0);
+    cout << "min_" << name << ": " << data.front() << endl;
+    cout << "firstquartile_" << name << ": " << quantile(data, 0.25) << endl;
+    cout << "median_" << name << ": " << quantile(data, 0.5) << endl;
+    cout << "thirdquartile_" << name << ": " << quantile(data, 0.75) << endl;
+    cout << "max_" << name << ": " << data.back() << endl;
+    if (!harmonic) {
+        cout << "mean_" << name << ": " << mean << endl;
+        cout << "stddev_" << name << ": " << sqrt(variance) << endl;
+        return;
+    }
+    // rates are averaged harmonically, as in the Graph500 reference code
+    double inverse_mean = 0, inverse_variance = 0;
+    for (double x : data) inverse_mean += 1.0 / x / n;
+    for (double x : data) inverse_variance += (1.0 / x - inverse_mean) * (1.0 / x - inverse_mean) / max(n - 1, 1.0);
+    cout << "harmonic_mean_" << name << ": " << 1.0 / inverse_mean << endl;
+    cout << "harmonic_stddev_" << name << ": " << sqrt(inverse_variance / n) / (inverse_mean * inverse_mean) << endl;
+}
+
+void graph500(Graph& g) {
+    vector<VertexId> roots = sample_roots(g, graph500_num_roots);
+    if (roots.empty()) {
+        if (rank_me() == 0) cout << "Graph has no edges" << endl;
+        exit(-1);
+    }
+    global_ptr<VertexId> parent_dist = new_array<VertexId>(g.num_nodes); VertexId* parent = parent_dist.local();
+    vector<double> times, nedges, teps;
+    for (VertexId root : roots) {
+        barrier();
+        auto time_before = std::chrono::system_clock::now();
+        Distance* dist = bfs(g, root, parent);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+
+        // validation is not part of the timed region
+        if (!validate(g, root, dist, parent)) {
+            if (rank_me() == 0) cerr << "Validation failed for root " << root << endl;
+            exit(-1);
+        }
+        EdgeId edges = traversed_edges(g, dist);
+        times.push_back(delta_time.count());
+        nedges.push_back(edges);
+        teps.push_back(edges / delta_time.count());
+        delete_array(to_global_ptr(dist));
+    }
+    delete_array(parent_dist);
+
+    if (rank_me() == 0) {
+        cout << "NBFS: " << roots.size() << endl;
+        cout << "num_nodes: " << g.num_nodes << endl;
+        cout << "num_edges: " << g.num_edges << endl;
+        print_statistics("time", times, false);
+        print_statistics("nedge", nedges, false);
+        print_statistics("TEPS", teps, true);
+    }
+}
 
 int main(int argc, char *argv[]) {
     if (argc != 3) {
@@ -236,7 +618,36 @@ int main(int argc, char *argv[]) {
 
     barrier(); 
     srand(time(NULL));
-    float current_time = 0.0;
+    if (BFS_MODE != nullptr && strcmp(BFS_MODE, "graph500") == 0) {
+        graph500(g);
+        barrier();
+        finalize();
+        return 0;
+    }
+    if (BFS_MODE != nullptr && strcmp(BFS_MODE, "multisource") == 0) {
+        int batch = max(1, min(ms_bfs_batch, ms_bfs_max_sources));
+        vector<VertexId> sources(batch);
+        double current_time = 0.0;
+        for (int i = 0; i < num_iters; i++) {
+            for (int s = 0; s < batch; s++) sources[s] = rand() % g.num_nodes;
+            broadcast(sources.data(), batch, 0).wait();
+            auto time_before = std::chrono::system_clock::now();
+            Distance* dist = ms_bfs(g, sources.data(), batch);
+            auto time_after = std::chrono::system_clock::now();
+            std::chrono::duration<double> delta_time = time_after - time_before;
+            current_time += delta_time.count();
+            delete_array(to_global_ptr(dist));
+            barrier();
+        }
+        if (rank_me() == 0) {
+            std::cout << current_time / num_iters << std::endl;
+        }
+        barrier();
+        finalize();
+        return 0;
+    }
+
+    double current_time = 0.0;
     for (int i = 0; i < num_iters; i++) {
         VertexId root = rand() % g.num_nodes;
         root = broadcast(root, 0).wait();
@@ -249,14 +660,12 @@ int main(int argc, char *argv[]) {
             for (VertexId i = 0; i < g.num_nodes; i++)
                 cout << dist[i] << endl;
         }*/
+        delete_array(to_global_ptr(dist));
         barrier();
     }
 
     if (rank_me() == 0) {
         std::cout << current_time / num_iters << std::endl;
-        /* if (!verify(g, root, dist)) {
-            std::cerr << "Verification not correct" << endl;
-        } */
     }
     barrier();
     finalize();
@@ -0,0 +1,148 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Distance-1 coloring of a symmetric graph by speculative first-fit with
+// conflict resolution, as in the OpenMP version. A rank colors its own
+// vertices one after the other, so conflicts can only arise across ranks:
+// a round colors the owned frontier, sends the new colors of the boundary
+// vertices, those with a neighbor on another rank, to just the ranks they
+// neighbor, and of two neighbors with the same color the one with the
+// larger id goes into the next frontier.
+
+typedef int Color;
+
+// the colors this rank knows: its own vertices' and its neighbors'
+struct ColorBlock {
+    Color* colors;
+};
+
+// the smallest color none of u's neighbors has; forbidden is all clear on
+// entry and exit
+Color first_fit(Graph& g, VertexId u, const Color* colors, vector<uint64_t>& forbidden) {
+    EdgeId degree = g.out_degree(u);
+    size_t num_words = degree / 64 + 1;
+    if (forbidden.size() < num_words) forbidden.resize(num_words, 0);
+
+    VertexId* neighbors = g.out_neighbors(u).local();
+    for (EdgeId j = 0; j < degree; j++) {
+        Color c = colors[neighbors[j]];
+        if (c >= 0 && c <= degree) forbidden[c / 64] |= 1UL << (c % 64);
+    }
+    Color color = -1;
+    for (size_t w = 0; w < num_words; w++) {
+        if (color < 0 && ~forbidden[w] != 0) color = w * 64 + __builtin_ctzll(~forbidden[w]);
+        forbidden[w] = 0;
+    }
+    return color;
+}
+
+// colors the owned frontier and sends the colors of its boundary vertices
+// to the ranks they neighbor
+void color_frontier(Graph& g, dist_object<ColorBlock>& block, const vector<VertexId>& frontier, vector<uint64_t>& forbidden) {
+    Color* colors = block->colors;
+    vector<vector<pair<VertexId, Color>>> updates(rank_n());
+    vector<VertexId> sent_to(rank_n(), -1);
+    for (VertexId u : frontier) {
+        colors[u] = first_fit(g, u, colors, forbidden);
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            int r = g.vertex_rank(neighbors[j]);
+            if (r == rank_me() || sent_to[r] == u) continue;
+            sent_to[r] = u;
+            updates[r].push_back(make_pair(u, colors[u]));
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (updates[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<ColorBlock>& block, view<pair<VertexId, Color>> updates) {
+            for (auto& update : updates) block->colors[update.first] = update.second;
+        }, block, make_view(updates[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' colors of our neighbors are in once all are done
+    barrier();
+}
+
+Color* coloring(Graph& g) {
+    global_ptr<Color> colors_dist = new_array<Color>(g.num_nodes); Color* colors = colors_dist.local();
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        colors[i] = -1;
+    }
+    dist_object<ColorBlock> block(ColorBlock{colors});
+    vector<uint64_t> forbidden;
+
+    vector<VertexId> frontier;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        frontier.push_back(u);
+    }
+    // nobody may send colors before every rank has cleared its own
+    barrier();
+
+    VertexId round = 0;
+    VertexId frontier_size;
+    while ((frontier_size = reduce_all((VertexId) frontier.size(), op_fast_add).wait()) != 0) {
+        round++;
+        if (DEBUG && rank_me() == 0) cout << "Round " << round << " | " << "Frontier: " << frontier_size << endl;
+        color_frontier(g, block, frontier, forbidden);
+
+        // owned neighbors were colored in order, only remote ones can clash
+        vector<VertexId> frontier_next;
+        for (VertexId u : frontier) {
+            VertexId* neighbors = g.out_neighbors(u).local();
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                VertexId v = neighbors[j];
+                if (v < u && colors[v] == colors[u]) {
+                    frontier_next.push_back(u);
+                    break;
+                }
+            }
+        }
+        swap(frontier, frontier_next);
+    }
+    // only the owned block and the neighbors' colors are set
+    return colors;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./coloring <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    Color num_colors = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        Color* colors = coloring(g);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        num_colors = g.num_nodes_local > 0 ? *max_element(colors + g.rank_start, colors + g.rank_end) + 1 : 0;
+        num_colors = reduce_all(num_colors, op_fast_max).wait();
+        delete_array(to_global_ptr(colors));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "colors: " << num_colors << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
@@ -0,0 +1,246 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Community detection on a symmetric graph by label propagation, as in the
+// OpenMP version. Every rank knows the labels of its own vertices and of
+// their neighbors, and updates its own ones in place, one after the other.
+// After each round the new labels of the boundary vertices, those with a
+// neighbor on another rank, are sent to just the ranks they neighbor.
+// Every owned vertex is revisited each round, as a rank cannot tell which
+// of its vertices neighbor a remote vertex whose label changed. A boundary
+// vertex only sees its remote neighbors' labels of the round before, so two
+// of them on different ranks that update in the same round can adopt each
+// other's label and swap forever. Boundary vertices therefore update in
+// about every other round, picked by a hash of the vertex and the round,
+// which soon has any two neighbors take turns.
+
+// label propagation stops after LP_MAX_ITERS rounds even if labels still
+// change, which they can keep doing on near-bipartite parts of the graph
+const int lp_max_iters = env_double("LP_MAX_ITERS", 20);
+
+// the labels this rank knows: its own vertices' and its neighbors'
+struct LabelBlock {
+    VertexId* labels;
+};
+
+// open addressing from labels to counts. It only grows, and is cleared
+// through the list of the slots in use
+struct HashCounter {
+    vector<VertexId> keys;
+    vector<EdgeId> counts;
+    vector<size_t> used;
+
+    // room for n distinct keys; the table must be empty
+    void reserve(EdgeId n) {
+        size_t capacity = 16;
+        while (capacity < 2 * (size_t) n) capacity *= 2;
+        if (keys.size() < capacity) {
+            keys.assign(capacity, -1);
+            counts.assign(capacity, 0);
+        }
+    }
+
+    void add(VertexId key) {
+        size_t mask = keys.size() - 1;
+        size_t i = utils::hash(key) & mask;
+        while (keys[i] != key && keys[i] != -1) i = (i + 1) & mask;
+        if (keys[i] == -1) {
+            keys[i] = key;
+            used.push_back(i);
+        }
+        counts[i]++;
+    }
+
+    void clear() {
+        for (size_t i : used) {
+            keys[i] = -1;
+            counts[i] = 0;
+        }
+        used.clear();
+    }
+};
+
+// hashed order of the labels as u sees them, ties broken by id
+inline bool higher_priority(VertexId a, VertexId b, VertexId u) {
+    unsigned int ha = utils::hash(a ^ utils::hash(u)), hb = utils::hash(b ^ utils::hash(u));
+    return ha > hb || (ha == hb && a > b);
+}
+
+// the label most of u's neighbors have. u keeps its own if that is one of
+// the most frequent, otherwise the one first in u's hashed order wins
+VertexId most_frequent_label(Graph& g, VertexId u, const VertexId* labels, HashCounter& counts) {
+    EdgeId degree = g.out_degree(u);
+    counts.reserve(degree);
+    VertexId* neighbors = g.out_neighbors(u).local();
+    for (EdgeId j = 0; j < degree; j++) {
+        if (neighbors[j] != u) counts.add(labels[neighbors[j]]);
+    }
+
+    VertexId own = labels[u], best = own;
+    EdgeId best_count = 0, own_count = 0;
+    for (size_t i : counts.used) {
+        VertexId label = counts.keys[i];
+        EdgeId count = counts.counts[i];
+        if (label == own) own_count = count;
+        if (count > best_count || (count == best_count && higher_priority(label, best, u))) {
+            best = label;
+            best_count = count;
+        }
+    }
+    counts.clear();
+    return own_count == best_count ? own : best;
+}
+
+// whether an owned vertex has a neighbor on another rank
+vector<bool> boundary_vertices(Graph& g) {
+    vector<bool> boundary(g.num_nodes_local, false);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u) && !boundary[u - g.rank_start]; j++) {
+            if (g.vertex_rank(neighbors[j]) != rank_me()) boundary[u - g.rank_start] = true;
+        }
+    }
+    return boundary;
+}
+
+// updates the owned labels in place and sends the changed boundary ones to
+// the ranks they neighbor. Returns how many owned labels changed or would
+// have, had their boundary vertex not sat the round out
+VertexId label_propagation_round(Graph& g, dist_object<LabelBlock>& block, const vector<bool>& boundary, VertexId round, HashCounter& counts) {
+    VertexId* labels = block->labels;
+    vector<vector<pair<VertexId, VertexId>>> updates(rank_n());
+    vector<VertexId> sent_to(rank_n(), -1);
+    VertexId num_changed = 0;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        VertexId label = most_frequent_label(g, u, labels, counts);
+        if (label == labels[u]) continue;
+        num_changed++;
+        if (boundary[u - g.rank_start] && (utils::hash(u ^ utils::hash(round)) & 1)) continue;
+        labels[u] = label;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            int r = g.vertex_rank(neighbors[j]);
+            if (r == rank_me() || sent_to[r] == u) continue;
+            sent_to[r] = u;
+            updates[r].push_back(make_pair(u, label));
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (updates[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<LabelBlock>& block, view<pair<VertexId, VertexId>> updates) {
+            for (auto& update : updates) block->labels[update.first] = update.second;
+        }, block, make_view(updates[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' labels of our neighbors are in once all are done
+    barrier();
+    return num_changed;
+}
+
+VertexId* label_propagation(Graph& g) {
+    global_ptr<VertexId> labels_dist = new_array<VertexId>(g.num_nodes); VertexId* labels = labels_dist.local();
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        labels[i] = i;
+    }
+    dist_object<LabelBlock> block(LabelBlock{labels});
+    vector<bool> boundary = boundary_vertices(g);
+    HashCounter counts;
+    // nobody may send labels before every rank has set its own
+    barrier();
+
+    VertexId round = 0;
+    // a round that changes nothing on any rank is final: a vertex that sat
+    // it out counts as changed, so the search goes on until it has had
+    // its turn
+    VertexId num_changed = g.num_nodes;
+    while (num_changed != 0 && round < lp_max_iters) {
+        round++;
+        num_changed = label_propagation_round(g, block, boundary, round, counts);
+        num_changed = reduce_all(num_changed, op_fast_add).wait();
+        if (DEBUG && rank_me() == 0) cout << "Round " << round << " | " << "Changed: " << num_changed << endl;
+    }
+    // only the owned block and the neighbors' labels are set
+    return labels;
+}
+
+// modularity of the partition into labels, every edge of weight one, and
+// the number of communities in it
+pair<double, VertexId> modularity(Graph& g, const VertexId* labels) {
+    vector<double> community_degree(g.num_nodes, 0);
+    EdgeId internal = 0;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        community_degree[labels[u]] += g.out_degree(u);
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            if (labels[neighbors[j]] == labels[u]) internal++;
+        }
+    }
+    reduce_all(community_degree.data(), community_degree.data(), g.num_nodes, op_fast_add).wait();
+    internal = reduce_all(internal, op_fast_add).wait();
+
+    // isolated vertices are communities of degree zero
+    vector<char> is_label(g.num_nodes, 0);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        is_label[labels[u]] = 1;
+    }
+    reduce_all(is_label.data(), is_label.data(), g.num_nodes, op_fast_max).wait();
+    VertexId num_communities = 0;
+    for (VertexId c = 0; c < g.num_nodes; c++) {
+        num_communities += is_label[c];
+    }
+
+    double total_weight = g.num_edges;
+    if (total_weight == 0) return make_pair(0.0, num_communities);
+    double expected = 0;
+    for (VertexId c = 0; c < g.num_nodes; c++) {
+        expected += (community_degree[c] / total_weight) * (community_degree[c] / total_weight);
+    }
+    return make_pair(internal / total_weight - expected, num_communities);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./communities <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    VertexId num_communities = 0;
+    double q = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        VertexId* labels = label_propagation(g);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        pair<double, VertexId> result = modularity(g, labels);
+        q = result.first;
+        num_communities = result.second;
+        delete_array(to_global_ptr(labels));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "communities: " << num_communities << std::endl;
+        std::cout << "modularity: " << q << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
@@ -3,6 +3,8 @@
 #include <chrono>
 #include <ctime> 
 #include <climits>
+#include <cstring>
+#include <algorithm>
 #include <stdlib.h> 
 #include <time.h>
 #include "sequence.hpp"
@@ -11,20 +13,24 @@ using namespace upcxx;
 
 struct nonNegF{bool operator() (VertexId a) {return (a>=0);}};
 
-void sync_round_sparse(Graph& g, VertexId* labels_next, VertexId* frontier_next) {
-    reduce_all(labels_next, labels_next, g.num_nodes, op_fast_min).wait();
+// CC_MODE=unionfind selects the distributed union-find instead of label
+// propagation
+const char* CC_MODE = std::getenv("CC_MODE");
+
+void sync_round_sparse(Graph& g, VertexId* labels, VertexId* frontier_next) {
+    reduce_all(labels, labels, g.num_nodes, op_fast_min).wait();
     reduce_all(frontier_next, frontier_next, g.num_nodes, op_fast_max).wait();
     barrier();
 }
 
-VertexId cc_sparse(Graph& g, global_ptr<VertexId> labels_dist, global_ptr<VertexId> labels_next_dist, global_ptr<VertexId> frontier_dist, global_ptr<VertexId> frontier_next_dist, VertexId frontier_size, VertexId level) {
+VertexId cc_sparse(Graph& g, global_ptr<VertexId> labels_dist, global_ptr<VertexId> frontier_dist, global_ptr<VertexId> frontier_next_dist, VertexId frontier_size, VertexId level) {
     VertexId* labels = labels_dist.local();
-    VertexId* labels_next = labels_next_dist.local();
     VertexId* frontier = frontier_dist.local();
     VertexId* frontier_next = frontier_next_dist.local();
 
+    // labels only ever decrease, so they are lowered in place and merged
+    // with a min-reduction; frontier_next records which vertices changed
     for (VertexId i = 0; i < g.num_nodes; i++) {
-        labels_next[i] = labels[i];
         frontier_next[i] = -1;
     }
 
@@ -34,35 +40,34 @@ VertexId cc_sparse(Graph& g, global_ptr<VertexId> labels_dist, global_ptr<Vertex
         VertexId* neighbors = g.out_neighbors(u).local();
         for (EdgeId j = 0; j < g.out_degree(u); j++) {
             VertexId v = neighbors[j];
-            if (labels_next[v] > labels[u]) {
-                labels_next[v] = labels[u];
+            if (labels[v] > labels[u]) {
+                labels[v] = labels[u];
                 frontier_next[v] = v;
             }
         }
     }
     barrier();
-    sync_round_sparse(g, labels_next, frontier_next);
+    sync_round_sparse(g, labels, frontier_next);
     frontier_size = sequence::filter(frontier_next, frontier, g.num_nodes, nonNegF());
     return frontier_size; 
 }
 
-void sync_round_dense(Graph& g, VertexId* labels_next, bool* frontier_next) {  
+void sync_round_dense(Graph& g, VertexId* labels, bool* frontier_next) {  
     for (VertexId i = 0; i < rank_n(); i++) {
-        broadcast(labels_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+        broadcast(labels+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
         broadcast(frontier_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
     }
     barrier();
 }
 
-VertexId cc_dense(Graph& g, global_ptr<VertexId> labels_dist, global_ptr<VertexId> labels_next_dist, global_ptr<bool> frontier_dist, global_ptr<bool> frontier_next_dist, VertexId level) {
+VertexId cc_dense(Graph& g, global_ptr<VertexId> labels_dist, global_ptr<bool> frontier_dist, global_ptr<bool> frontier_next_dist, VertexId level) {
     VertexId* labels = labels_dist.local();
-    VertexId* labels_next = labels_next_dist.local();
     bool* frontier = frontier_dist.local();
     bool* frontier_next = frontier_next_dist.local();
 
-    for (VertexId u = 0; u < g.num_nodes; u++) {
-        // update next round of dist
-        labels_next[u] = labels[u];
+    // only the local block is written here, the rest of labels and
+    // frontier_next is overwritten by the owners in sync_round_dense
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
         frontier_next[u] = false;
     }
 
@@ -74,22 +79,26 @@ VertexId cc_dense(Graph& g, global_ptr<VertexId> labels_dist, global_ptr<VertexI
 
             if (!frontier[v]) continue;
 
-            if (labels_next[u] > labels[v]) {
-                labels_next[u] = labels[v]; 
+            if (labels[u] > labels[v]) {
+                labels[u] = labels[v]; 
                 compare_and_compare_and_swap(&frontier_next[u]);
             }
         }
 
     }
     barrier();
-    sync_round_dense(g, labels_next, frontier_next);
+    sync_round_dense(g, labels, frontier_next);
     VertexId frontier_size = sequence::sumFlagsSerial(frontier_next, g.num_nodes);
 
     return frontier_size;
 }
 
 
-void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense) {
+void sparse_to_dense(VertexId* frontier_sparse, VertexId frontier_size, bool* frontier_dense, VertexId num_nodes) {
+    // clear flags left over from the last dense round
+    for (VertexId i = 0; i < num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
     for (VertexId i = 0; i < frontier_size; i++) {
         frontier_dense[frontier_sparse[i]] = true;
     }
@@ -109,7 +118,6 @@ void dense_to_sparse(bool* frontier_dense, VertexId num_nodes, VertexId* frontie
 VertexId* cc(Graph &g) {
     // https://github.com/sbeamer/gapbs/blob/master/src/pr.cc
     global_ptr<VertexId> labels_dist = new_array<VertexId>(g.num_nodes); VertexId* labels = labels_dist.local();
-    global_ptr<VertexId> labels_next_dist = new_array<VertexId>(g.num_nodes); VertexId* labels_next = labels_next_dist.local();
 
     global_ptr<VertexId> frontier_sparse_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse = frontier_sparse_dist.local();
     global_ptr<VertexId> frontier_sparse_next_dist = new_array<VertexId>(g.num_nodes); VertexId* frontier_sparse_next = frontier_sparse_next_dist.local();
@@ -141,34 +149,220 @@ VertexId* cc(Graph &g) {
                 dense_to_sparse(frontier_dense, g.num_nodes, frontier_sparse);
             }
             is_sparse_mode = true;
-            frontier_size = cc_sparse(g, labels_dist, labels_next_dist, frontier_sparse_dist, frontier_sparse_next_dist, frontier_size, level);
+            frontier_size = cc_sparse(g, labels_dist, frontier_sparse_dist, frontier_sparse_next_dist, frontier_size, level);
         } else {
             if (is_sparse_mode) {
-                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense);
+                sparse_to_dense(frontier_sparse, frontier_size, frontier_dense, g.num_nodes);
             }
             is_sparse_mode = false;
-            frontier_size = cc_dense(g, labels_dist, labels_next_dist, frontier_dense_dist, frontier_dense_next_dist, level);
+            frontier_size = cc_dense(g, labels_dist, frontier_dense_dist, frontier_dense_next_dist, level);
 
             swap(frontier_dense_next_dist, frontier_dense_dist);
             swap(frontier_dense_next, frontier_dense);
         }
 
-        swap(labels_next_dist, labels_dist);
-        swap(labels_next, labels);
         barrier();
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
         if (DEBUG && rank_me() == 0) cout << "Time: " << delta.count() << endl;
     }
 
-    delete_array(labels_next_dist); delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist); delete_array(frontier_dense_next_dist);
+    delete_array(frontier_sparse_dist); delete_array(frontier_sparse_next_dist); delete_array(frontier_dense_dist); delete_array(frontier_dense_next_dist);
 
     return labels; 
 }
 
+// Distributed union-find: every rank first unions the edges inside its own
+// partition, then the cut edges drive hooks of one root under another,
+// sent in one batched RPC per owning rank, and a few rounds of batched
+// pointer jumping bring every vertex back to its root. Communication is
+// proportional to the cut edges instead of n per level. Hooks always point
+// a root at a smaller id, so each component ends up rooted at its smallest
+// vertex, the same labels label propagation produces.
+
+// parent pointers of the owned vertices, indexed by global vertex id
+struct ParentBlock {
+    VertexId* parent;
+    VertexId start;
+    VertexId& operator[](VertexId v) { return parent[v - start]; }
+};
+
+// returns parent[v] for each of the sorted, distinct ids, with one RPC per
+// rank that owns any of them
+vector<VertexId> fetch_parents(Graph& g, dist_object<ParentBlock>& parents, const vector<VertexId>& ids) {
+    vector<vector<VertexId>> requests(rank_n());
+    for (VertexId v : ids) {
+        requests[g.vertex_rank(v)].push_back(v);
+    }
+
+    vector<future<vector<VertexId>>> replies;
+    for (int r = 0; r < rank_n(); r++) {
+        if (requests[r].empty() || r == rank_me()) continue;
+        replies.push_back(rpc(r, [](dist_object<ParentBlock>& parents, view<VertexId> ids) {
+            vector<VertexId> values;
+            values.reserve(ids.size());
+            for (VertexId v : ids) values.push_back((*parents)[v]);
+            return values;
+        }, parents, make_view(requests[r])));
+    }
+
+    // ids are sorted and ranks own ascending blocks, so the replies
+    // concatenate back into the order of ids
+    vector<VertexId> values;
+    values.reserve(ids.size());
+    size_t k = 0;
+    for (int r = 0; r < rank_n(); r++) {
+        if (requests[r].empty()) continue;
+        if (r == rank_me()) {
+            for (VertexId v : requests[r]) values.push_back((*parents)[v]);
+        } else {
+            vector<VertexId> reply = replies[k++].wait();
+            values.insert(values.end(), reply.begin(), reply.end());
+        }
+    }
+    return values;
+}
+
+// distinct values of v, sorted
+vector<VertexId> sorted_unique(vector<VertexId> v) {
+    sort(v.begin(), v.end());
+    v.erase(unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+VertexId lookup(const vector<VertexId>& ids, const vector<VertexId>& values, VertexId v) {
+    return values[lower_bound(ids.begin(), ids.end(), v) - ids.begin()];
+}
+
+// points every owned vertex at its root
+void jump_to_roots(Graph& g, dist_object<ParentBlock>& parents) {
+    ParentBlock& parent = *parents;
+    while (true) {
+        // local chains need no communication
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            while (g.rank_start <= parent[u] && parent[u] < g.rank_end && parent[parent[u]] != parent[u]) {
+                parent[u] = parent[parent[u]];
+            }
+        }
+
+        vector<VertexId> remote;
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            if (!(g.rank_start <= parent[u] && parent[u] < g.rank_end)) remote.push_back(parent[u]);
+        }
+        remote = sorted_unique(remote);
+        vector<VertexId> grandparents = fetch_parents(g, parents, remote);
+
+        // other ranks may still be reading our pointers, which is fine as
+        // any ancestor of a vertex is as good as its parent
+        VertexId changed = 0;
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            if (g.rank_start <= parent[u] && parent[u] < g.rank_end) continue;
+            VertexId grandparent = lookup(remote, grandparents, parent[u]);
+            if (grandparent != parent[u]) {
+                parent[u] = grandparent;
+                changed++;
+            }
+        }
+        if (reduce_all(changed, op_fast_add).wait() == 0) break;
+    }
+}
+
+VertexId* cc_union_find(Graph& g) {
+    vector<VertexId> parent_local(g.num_nodes_local);
+    dist_object<ParentBlock> parents(ParentBlock{parent_local.data(), g.rank_start});
+    ParentBlock& parent = *parents;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        parent[u] = u;
+    }
+
+    // union the edges inside the partition, keeping the cut edges
+    vector<pair<VertexId, VertexId>> cut_edges;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            VertexId v = neighbors[j];
+            if (!(g.rank_start <= v && v < g.rank_end)) {
+                cut_edges.push_back(make_pair(u, v));
+                continue;
+            }
+            // find with path halving, then hook the higher root
+            VertexId ru = u, rv = v;
+            while (parent[ru] != ru) ru = parent[ru] = parent[parent[ru]];
+            while (parent[rv] != rv) rv = parent[rv] = parent[parent[rv]];
+            if (ru != rv) parent[max(ru, rv)] = min(ru, rv);
+        }
+    }
+    barrier();
+
+    VertexId round = 0;
+    while (true) {
+        round++;
+        jump_to_roots(g, parents);
+        barrier();
+
+        // replace both endpoints of every cut edge by their roots, dropping
+        // edges inside a single tree; those never separate again since
+        // only roots get hooked
+        vector<VertexId> endpoints;
+        for (auto& e : cut_edges) {
+            endpoints.push_back(e.first);
+            endpoints.push_back(e.second);
+        }
+        endpoints = sorted_unique(endpoints);
+        vector<VertexId> roots = fetch_parents(g, parents, endpoints);
+
+        vector<pair<VertexId, VertexId>> remaining;
+        for (auto& e : cut_edges) {
+            VertexId ru = lookup(endpoints, roots, e.first);
+            VertexId rv = lookup(endpoints, roots, e.second);
+            if (ru != rv) remaining.push_back(make_pair(max(ru, rv), min(ru, rv)));
+        }
+        sort(remaining.begin(), remaining.end());
+        remaining.erase(unique(remaining.begin(), remaining.end()), remaining.end());
+        swap(cut_edges, remaining);
+
+        VertexId num_cut_edges = reduce_all((VertexId) cut_edges.size(), op_fast_add).wait();
+        if (DEBUG && rank_me() == 0) cout << "Round " << round << " | " << "Cut edges: " << num_cut_edges << endl;
+        if (num_cut_edges == 0) break;
+
+        // hook the higher root of each edge under the lower one at the
+        // owner of the higher root. Lookups are done everywhere before
+        // any root moves, and when several hooks hit the same root the
+        // smallest wins; the others are retried next round
+        vector<vector<VertexId>> hooks(rank_n());
+        for (auto& e : cut_edges) {
+            hooks[g.vertex_rank(e.first)].push_back(e.first);
+            hooks[g.vertex_rank(e.first)].push_back(e.second);
+        }
+        vector<future<>> acks;
+        for (int r = 0; r < rank_n(); r++) {
+            if (hooks[r].empty()) continue;
+            acks.push_back(rpc(r, [](dist_object<ParentBlock>& parents, view<VertexId> hooks) {
+                for (size_t i = 0; i < hooks.size(); i += 2) {
+                    VertexId& p = (*parents)[hooks[i]];
+                    if (hooks[i+1] < p) p = hooks[i+1];
+                }
+            }, parents, make_view(hooks[r])));
+        }
+        for (auto& ack : acks) ack.wait();
+        barrier();
+    }
+
+    // same replicated labels as cc()
+    global_ptr<VertexId> labels_dist = new_array<VertexId>(g.num_nodes); VertexId* labels = labels_dist.local();
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        labels[u] = parent[u];
+    }
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(labels+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+    barrier();
+    return labels;
+}
+
 int main(int argc, char *argv[]) {
     if (argc != 3) {
-        cout << "Usage: ./bellman_ford <path_to_graph> <num_iters>" << endl;
+        cout << "Usage: ./connected_components <path_to_graph> <num_iters>" << endl;
         exit(-1);
     }
     
@@ -179,10 +373,11 @@ int main(int argc, char *argv[]) {
 
     barrier(); 
     srand(time(NULL));
-    float current_time = 0.0;
+    bool use_union_find = CC_MODE != nullptr && strcmp(CC_MODE, "unionfind") == 0;
+    double current_time = 0.0;
     for (int i = 0; i < num_iters; i++) {
         auto time_before = std::chrono::system_clock::now();
-        VertexId* labels = cc(g);
+        VertexId* labels = use_union_find ? cc_union_find(g) : cc(g);
         auto time_after = std::chrono::system_clock::now();
         std::chrono::duration<double> delta_time = time_after - time_before;
         current_time += delta_time.count();
@@ -190,6 +385,7 @@ int main(int argc, char *argv[]) {
             for (VertexId i = 0; i < g.num_nodes; i++)
                 cout << labels[i] << endl;
         } */
+        delete_array(to_global_ptr(labels));
         barrier();
     }
     
@@ -0,0 +1,226 @@
+#include "graph_weighted.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Delta-stepping SSSP (Meyer and Sanders, "Delta-stepping: a
+// parallelizable shortest path algorithm"). Each rank keeps buckets of width
+// delta for the vertices it owns; light edges (weight <= delta) of the
+// lowest bucket are relaxed until it stays empty on every rank, then the
+// heavy edges of every vertex it settled are relaxed once. A rank relaxes
+// the edges into its own vertices directly and sends the others to their
+// owners as one rpc per rank, so a round only moves the relaxations it
+// makes; the owners queue the vertices that improved into their buckets.
+// dist is replicated once at the end, as bellman_ford returns it.
+
+const size_t max_bin = ULONG_MAX / 2;
+
+// SSSP_DELTA sets the bucket width; otherwise it is chosen from the graph
+const double SSSP_DELTA = env_double("SSSP_DELTA", 0);
+
+// the largest weight over the average degree, Meyer and Sanders' choice
+// for uniformly random weights
+Weight choose_delta(Graph& g) {
+    if (SSSP_DELTA >= 1) return (Weight) SSSP_DELTA;
+    Weight max_weight = 0;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        Weight* weights = g.out_weights_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            max_weight = max(max_weight, weights[j]);
+        }
+    }
+    max_weight = reduce_all(max_weight, op_fast_max).wait();
+    if (g.num_edges == 0) return 1;
+    return max((Weight) 1, max_weight * g.num_nodes / g.num_edges);
+}
+
+// a relaxation of an edge into a vertex of another rank
+struct Relaxation {
+    VertexId v;
+    Weight dist;
+};
+
+// the owned block of the distances, the target of remote relaxations
+struct RelaxBlock {
+    Weight* dist;
+    bool* queued;
+    vector<VertexId>* improved;
+    VertexId start;
+
+    // lowers v's distance to d if that is shorter, noting v once per round
+    void relax(VertexId v, Weight d) {
+        if (d >= dist[v]) return;
+        dist[v] = d;
+        if (!queued[v - start]) {
+            queued[v - start] = true;
+            improved->push_back(v);
+        }
+    }
+};
+
+// relaxes the light or heavy edges of the owned vertices in frontier, the
+// remote ones aggregated per owner rank. dist of a remote vertex holds the
+// best this rank has sent for it, so it only sends improvements. Returns
+// the number of edges relaxed
+EdgeId relax_edges(Graph& g, dist_object<RelaxBlock>& block, const vector<VertexId>& frontier, Weight delta, bool light) {
+    Weight* dist = block->dist;
+    vector<vector<Relaxation>> relaxations(rank_n());
+    EdgeId relaxed = 0;
+    for (VertexId u : frontier) {
+        VertexId* neighbors = g.out_neighbors(u).local();
+        Weight* weights = g.out_weights_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            if ((weights[j] <= delta) != light) continue;
+            relaxed++;
+            VertexId v = neighbors[j];
+            Weight relax_dist = dist[u] + weights[j];
+            if (g.rank_start <= v && v < g.rank_end) {
+                block->relax(v, relax_dist);
+            } else if (relax_dist < dist[v]) {
+                dist[v] = relax_dist;
+                relaxations[g.vertex_rank(v)].push_back(Relaxation{v, relax_dist});
+            }
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (relaxations[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<RelaxBlock>& block, view<Relaxation> relaxations) {
+            for (const Relaxation& r : relaxations) block->relax(r.v, r.dist);
+        }, block, make_view(relaxations[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' relaxations of our vertices are in once all are done
+    barrier();
+    return relaxed;
+}
+
+// queues the owned vertices that improved in the round in the bucket of
+// their new distance
+void queue_improved(dist_object<RelaxBlock>& block, Weight delta, vector<vector<VertexId>>& bins) {
+    for (VertexId v : *block->improved) {
+        block->queued[v - block->start] = false;
+        size_t dest_bin = block->dist[v] / delta;
+        if (dest_bin >= bins.size()) bins.resize(dest_bin + 1);
+        bins[dest_bin].push_back(v);
+    }
+    block->improved->clear();
+}
+
+Weight* delta_stepping(Graph& g, VertexId root, Weight delta, EdgeId& relaxations) {
+    global_ptr<Weight> dist_dist = new_array<Weight>(g.num_nodes); Weight* dist = dist_dist.local();
+    bool* queued = new bool[g.num_nodes_local]();
+    vector<VertexId> improved;
+    dist_object<RelaxBlock> block(RelaxBlock{dist, queued, &improved, g.rank_start});
+    // last bucket whose heavy phase an owned vertex was queued for
+    vector<size_t> settled_bin(g.num_nodes_local, max_bin);
+
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        dist[i] = INF;
+    }
+    dist[root] = 0;
+
+    vector<vector<VertexId>> bins(1);
+    if (g.rank_start <= root && root < g.rank_end) bins[0].push_back(root);
+
+    size_t bin = 0;
+    EdgeId local_relaxed = 0;
+
+    while (bin != max_bin) {
+        vector<VertexId> settled;
+        // light phase: relax the current bucket until no rank refills it
+        while (true) {
+            vector<VertexId> frontier;
+            if (bin < bins.size()) swap(frontier, bins[bin]);
+            // skip entries whose vertex has since moved to a lower
+            // distance, they were queued again when it did
+            frontier.erase(remove_if(frontier.begin(), frontier.end(), [&](VertexId u) {
+                return (size_t) (dist[u] / delta) != bin;
+            }), frontier.end());
+            VertexId frontier_size = reduce_all((VertexId) frontier.size(), op_fast_add).wait();
+            if (frontier_size == 0) break;
+            if (DEBUG && rank_me() == 0) cout << "Bucket " << bin << " | " << "Frontier: " << frontier_size << endl;
+
+            for (VertexId u : frontier) {
+                if (settled_bin[u - g.rank_start] == bin) continue;
+                settled_bin[u - g.rank_start] = bin;
+                settled.push_back(u);
+            }
+
+            local_relaxed += relax_edges(g, block, frontier, delta, true);
+            queue_improved(block, delta, bins);
+        }
+
+        // heavy phase: the bucket is final, so each heavy edge only needs
+        // relaxing once and can only reach later buckets
+        local_relaxed += relax_edges(g, block, settled, delta, false);
+        queue_improved(block, delta, bins);
+
+        size_t next_bin = max_bin;
+        for (size_t i = bin + 1; i < bins.size(); i++) {
+            if (!bins[i].empty()) {
+                next_bin = i;
+                break;
+            }
+        }
+        bin = reduce_all(next_bin, op_fast_min).wait();
+    }
+    relaxations = reduce_all(local_relaxed, op_fast_add).wait();
+
+    // only the owned distances are final, the rest are what this rank sent
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(dist+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+    // nobody may send to a block that is gone
+    barrier();
+    delete[] queued;
+    return dist;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./delta_stepping <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+    Weight delta = choose_delta(g);
+    if (DEBUG && rank_me() == 0) cout << "Delta: " << delta << endl;
+
+    barrier();
+    srand(time(NULL));
+    double current_time = 0.0;
+    double current_relaxations = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        VertexId root = rand() % g.num_nodes;
+        root = broadcast(root, 0).wait();
+        EdgeId relaxations;
+        auto time_before = std::chrono::system_clock::now();
+        Weight* dist = delta_stepping(g, root, delta, relaxations);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        current_relaxations += relaxations;
+        delete_array(to_global_ptr(dist));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        // work as edge relaxations per source, then the time on the last line
+        std::cout << "relaxations: " << current_relaxations / num_iters << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
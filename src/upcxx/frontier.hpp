@@ -0,0 +1,29 @@
+#ifndef FRONTIER_H_
+#define FRONTIER_H_
+
+#include "utils.hpp"
+
+// The direction-optimizing switch of bfs, for the traversals that share
+// it: Beamer et al.'s rule for when to go bottom-up and back. The edge
+// counts are global, summed over the ranks by the caller. Include after
+// graph.hpp or graph_weighted.hpp.
+
+// direction-optimizing parameters from Beamer et al., see
+// docs/Direction-Optimizing Breadth-First Search.pdf
+const double bfs_alpha = env_double("BFS_ALPHA", 15.0);
+const double bfs_beta = env_double("BFS_BETA", 18.0);
+
+// whether the next round goes top-down. frontier_edges and
+// unexplored_edges are m_f and m_u in Beamer et al.: the edges the
+// frontier would scan, and those of the vertices not reached yet
+inline bool next_sparse_mode(bool is_sparse_mode, VertexId num_nodes, VertexId frontier_size, VertexId prev_frontier_size, EdgeId frontier_edges, EdgeId unexplored_edges) {
+    if (is_sparse_mode) {
+        // go bottom-up once checking the frontier's edges costs more
+        // than checking the unexplored vertices' edges
+        return frontier_edges <= unexplored_edges / bfs_alpha;
+    }
+    // go back top-down once the frontier is small and shrinking
+    return frontier_size < num_nodes / bfs_beta && frontier_size < prev_frontier_size;
+}
+
+#endif
@@ -136,7 +136,9 @@ Graph::Graph(char *path) {
 }
 
 int Graph::vertex_rank(const VertexId n) {
-    return int(n / (num_nodes / rank_n()));
+    int rank = int(n / (num_nodes / rank_n()));
+    // the last rank also owns the num_nodes % rank_n() leftover vertices
+    return rank < rank_n() ? rank : rank_n() - 1;
 }
 
 EdgeId Graph::in_degree(const VertexId n)  {
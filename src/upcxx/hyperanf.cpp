@@ -0,0 +1,280 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+#include <stdlib.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Approximate neighborhood function by HyperANF, as in the OpenMP version.
+// Every rank knows the counters of its own vertices and of their
+// in-neighbors. A round builds the unions of the owned counters, and the
+// counters that grew are sent to just the ranks owning their
+// out-neighbors, the only ones that read them in the next round.
+
+// ANF_LOG_REGISTERS=b, from 3 to 16, gives every counter 2^b one-byte
+// registers, for a relative standard error of about 1.04 / 2^(b/2) per
+// counter
+const int anf_log_registers = env_double("ANF_LOG_REGISTERS", 6);
+
+// registers hold at most 64 - b + 1 < 128, so the top bit of every byte is
+// free for the broadword comparison
+const uint64_t high_bits = 0x8080808080808080UL;
+
+// the counters this rank knows and which of them grew in the last round
+struct CounterBlock {
+    uint8_t* counters;
+    bool* changed;
+    int num_registers;
+};
+
+// every register of a takes the larger of its value and b's. Returns
+// whether any grew
+inline bool union_into(uint8_t* a, const uint8_t* b, int num_registers) {
+    bool grew = false;
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= num_registers; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i larger = _mm256_max_epu8(x, y);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(larger, x)) != -1) {
+            _mm256_storeu_si256((__m256i*) (a + i), larger);
+            grew = true;
+        }
+    }
+#endif
+    for (; i < num_registers; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        // the top bit of a byte of (x | high) - y stays set where x >= y
+        uint64_t x_wins = (((x | high_bits) - y) & high_bits) >> 7;
+        uint64_t larger = (x & (x_wins * 0xFF)) | (y & ~(x_wins * 0xFF));
+        if (larger != x) {
+            memcpy(a + i, &larger, 8);
+            grew = true;
+        }
+    }
+    return grew;
+}
+
+// the counter of the single vertex v
+void init_counter(uint8_t* counter, VertexId v, int log_registers) {
+    int num_registers = 1 << log_registers;
+    memset(counter, 0, num_registers);
+    uint64_t h = ((uint64_t) utils::hash(v) << 32) | utils::hash(v ^ 0x5bd1e995);
+    uint64_t rest = h << log_registers;
+    int rank = rest == 0 ? 64 - log_registers + 1 : __builtin_clzll(rest) + 1;
+    if (rank > 64 - log_registers + 1) rank = 64 - log_registers + 1;
+    counter[h >> (64 - log_registers)] = rank;
+}
+
+// the HyperLogLog estimate of the size of the set, with the linear
+// counting correction for small ones
+double estimate(const uint8_t* counter, int num_registers) {
+    double alpha = num_registers == 16 ? 0.673 : num_registers == 32 ? 0.697 : num_registers == 64 ? 0.709 : 0.7213 / (1 + 1.079 / num_registers);
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < num_registers; i++) {
+        sum += ldexp(1.0, -counter[i]);
+        if (counter[i] == 0) zeros++;
+    }
+    double e = alpha * num_registers * num_registers / sum;
+    if (e <= 2.5 * num_registers && zeros > 0) e = num_registers * log((double) num_registers / zeros);
+    return e;
+}
+
+// one round over the owned vertices; the ones that grew go into grown
+void anf_round(Graph& g, dist_object<CounterBlock>& block, uint8_t* counters_next, vector<VertexId>& grown) {
+    uint8_t* counters = block->counters;
+    bool* changed = block->changed;
+    int num_registers = block->num_registers;
+    grown.clear();
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        uint8_t* next = counters_next + u * num_registers;
+        bool copied = false, grew = false;
+        VertexId* neighbors = g.in_neighbors(u).local();
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            VertexId v = neighbors[j];
+            if (!changed[v]) continue;
+            if (!copied) memcpy(next, counters + u * num_registers, num_registers);
+            copied = true;
+            if (union_into(next, counters + v * num_registers, num_registers)) grew = true;
+        }
+        if (grew) grown.push_back(u);
+    }
+
+    // the last round's changes are read by now, and this round's only come
+    // in after the barrier
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        changed[i] = false;
+    }
+    barrier();
+
+    vector<vector<VertexId>> ids(rank_n());
+    vector<vector<uint8_t>> registers(rank_n());
+    vector<VertexId> sent_to(rank_n(), -1);
+    for (VertexId u : grown) {
+        memcpy(counters + u * num_registers, counters_next + u * num_registers, num_registers);
+        changed[u] = true;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            int r = g.vertex_rank(neighbors[j]);
+            if (r == rank_me() || sent_to[r] == u) continue;
+            sent_to[r] = u;
+            ids[r].push_back(u);
+            registers[r].insert(registers[r].end(), counters + u * num_registers, counters + (u + 1) * num_registers);
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (ids[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<CounterBlock>& block, view<VertexId> ids, view<uint8_t> registers) {
+            auto it = registers.begin();
+            for (VertexId v : ids) {
+                uint8_t* counter = block->counters + v * block->num_registers;
+                for (int i = 0; i < block->num_registers; i++) counter[i] = *it++;
+                block->changed[v] = true;
+            }
+        }, block, make_view(ids[r]), make_view(registers[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' grown counters we read are in once all are done
+    barrier();
+}
+
+// the neighborhood function N(0), N(1), ... up to the last hop that adds
+// pairs. harmonic receives the owned vertices' estimated harmonic
+// centralities
+vector<double> hyperanf(Graph& g, vector<double>& harmonic) {
+    int num_registers = 1 << anf_log_registers;
+    vector<uint8_t> counters(g.num_nodes * num_registers, 0);
+    vector<uint8_t> counters_next(g.num_nodes * num_registers, 0);
+    bool* changed = new bool[g.num_nodes];
+    vector<double> estimates(g.num_nodes, 0);
+    dist_object<CounterBlock> block(CounterBlock{counters.data(), changed, num_registers});
+
+    // all counters start out as changed, so the ones of the remote
+    // in-neighbors are set up here as well
+    double total = 0;
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        init_counter(counters.data() + u * num_registers, u, anf_log_registers);
+        changed[u] = true;
+    }
+    harmonic.assign(g.num_nodes, 0);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        estimates[u] = estimate(counters.data() + u * num_registers, num_registers);
+        total += estimates[u];
+    }
+    vector<double> neighborhood(1, reduce_all(total, op_fast_add).wait());
+
+    vector<VertexId> grown;
+    VertexId hop = 0;
+    while (hop < g.num_nodes) {
+        hop++;
+        anf_round(g, block, counters_next.data(), grown);
+        if (reduce_all((VertexId) grown.size(), op_fast_add).wait() == 0) break;
+
+        total = 0;
+        for (VertexId u : grown) {
+            double e = estimate(counters.data() + u * num_registers, num_registers);
+            // the estimates are not monotone, only the counters are
+            if (e > estimates[u]) harmonic[u] += (e - estimates[u]) / hop;
+            estimates[u] = e;
+        }
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            total += estimates[u];
+        }
+        neighborhood.push_back(reduce_all(total, op_fast_add).wait());
+        if (DEBUG && rank_me() == 0) cout << "Hop " << hop << " | " << "N: " << neighborhood.back() << endl;
+    }
+
+    // nobody may send to a block that is gone
+    barrier();
+    delete[] changed;
+    return neighborhood;
+}
+
+// the hop by which the given fraction of the pairs at the last hop are
+// reached, interpolated between hops
+double effective_diameter(const vector<double>& neighborhood, double fraction) {
+    double target = fraction * neighborhood.back();
+    size_t t = 0;
+    while (t < neighborhood.size() && neighborhood[t] < target) t++;
+    if (t == 0) return 0;
+    return t - 1 + (target - neighborhood[t - 1]) / (neighborhood[t] - neighborhood[t - 1]);
+}
+
+// mean distance over the pairs of distinct vertices that are connected
+double average_distance(const vector<double>& neighborhood) {
+    double pairs = neighborhood.back() - neighborhood[0];
+    if (pairs <= 0) return 0;
+    double sum = 0;
+    for (size_t t = 1; t < neighborhood.size(); t++) {
+        sum += t * (neighborhood[t] - neighborhood[t - 1]);
+    }
+    return sum / pairs;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./hyperanf <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+    // the unions work on whole words of eight registers
+    if (anf_log_registers < 3 || anf_log_registers > 16) {
+        cout << "ANF_LOG_REGISTERS must be between 3 and 16" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    vector<double> harmonic;
+    vector<double> neighborhood;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        neighborhood = hyperanf(g, harmonic);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        barrier();
+    }
+
+    // the most central owned vertex of every rank, then the best of those
+    VertexId most_central = g.rank_start;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        if (harmonic[u] > harmonic[most_central]) most_central = u;
+    }
+    double best = g.num_nodes_local > 0 ? harmonic[most_central] : -1;
+    best = reduce_all(best, op_fast_max).wait();
+    VertexId candidate = g.num_nodes_local > 0 && harmonic[most_central] == best ? most_central : LONG_MAX;
+    most_central = reduce_all(candidate, op_fast_min).wait();
+
+    if (rank_me() == 0) {
+        std::cout << "neighborhood_function:";
+        for (double n_t : neighborhood) std::cout << " " << n_t;
+        std::cout << std::endl;
+        std::cout << "effective_diameter: " << effective_diameter(neighborhood, 0.9) << std::endl;
+        std::cout << "average_distance: " << average_distance(neighborhood) << std::endl;
+        if (g.num_nodes > 0) std::cout << "most_central: " << most_central << " " << best << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
@@ -0,0 +1,196 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// k-core decomposition of a symmetric graph by bucketed peeling, as in the
+// OpenMP version. Degrees live with the owner of each vertex. In sparse
+// rounds a rank gathers the decrements its frontier makes to every other
+// rank's vertices and sends them as one rpc per owner; in dense rounds the
+// frontier flags are replicated like in bfs and owners count their peeled
+// neighbors themselves.
+
+// the frontier is pushed from while it is under this fraction of the vertices
+const int threshold_fraction_denom = 20;
+
+// the owned block of the peeling state, the target of remote decrements
+struct PeelBlock {
+    EdgeId* degrees;
+    VertexId* core;
+    vector<VertexId>* frontier_next;
+    VertexId start;
+    VertexId k;
+
+    // lowers u's degree, queueing u once it drops to k
+    void decrement(VertexId u, EdgeId count) {
+        VertexId i = u - start;
+        if (core[i] >= 0) return;
+        degrees[i] -= count;
+        if (degrees[i] <= k) {
+            core[i] = k;
+            frontier_next->push_back(u);
+        }
+    }
+};
+
+// top-down: the frontier decrements the degrees of its neighbors, the
+// remote ones aggregated per owner rank
+void kcore_sparse(Graph& g, dist_object<PeelBlock>& block, const vector<VertexId>& frontier) {
+    vector<vector<VertexId>> decrements(rank_n());
+    for (VertexId v : frontier) {
+        VertexId* neighbors = g.out_neighbors(v).local();
+        for (EdgeId j = 0; j < g.out_degree(v); j++) {
+            VertexId u = neighbors[j];
+            if (g.rank_start <= u && u < g.rank_end) {
+                block->decrement(u, 1);
+            } else {
+                decrements[g.vertex_rank(u)].push_back(u);
+            }
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (decrements[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<PeelBlock>& block, view<VertexId> ids) {
+            for (VertexId u : ids) block->decrement(u, 1);
+        }, block, make_view(decrements[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' decrements to our vertices are in once all are done
+    barrier();
+}
+
+// bottom-up: owned remaining vertices count their neighbors in the
+// replicated frontier flags
+void kcore_dense(Graph& g, dist_object<PeelBlock>& block, const bool* frontier) {
+    vector<VertexId> peeled_counts(g.num_nodes_local, 0);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        if (block->core[u - g.rank_start] >= 0) continue;
+        VertexId* neighbors = g.in_neighbors(u).local();
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            if (frontier[neighbors[j]]) peeled_counts[u - g.rank_start]++;
+        }
+    }
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        if (peeled_counts[u - g.rank_start] > 0) block->decrement(u, peeled_counts[u - g.rank_start]);
+    }
+    barrier();
+}
+
+void sync_frontier_dense(Graph& g, const vector<VertexId>& frontier, bool* frontier_dense) {
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        frontier_dense[i] = false;
+    }
+    for (VertexId u : frontier) {
+        frontier_dense[u] = true;
+    }
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(frontier_dense+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+    barrier();
+}
+
+VertexId* kcore(Graph& g) {
+    vector<EdgeId> degrees(g.num_nodes_local);
+    global_ptr<VertexId> core_dist = new_array<VertexId>(g.num_nodes); VertexId* core = core_dist.local();
+    global_ptr<bool> frontier_dense_dist = new_array<bool>(g.num_nodes); bool* frontier_dense = frontier_dense_dist.local();
+    vector<VertexId> frontier, frontier_next;
+    dist_object<PeelBlock> block(PeelBlock{degrees.data(), core + g.rank_start, &frontier_next, g.rank_start, 0});
+
+    vector<VertexId> remaining;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        degrees[u - g.rank_start] = g.out_degree(u);
+        core[u] = -1;
+        remaining.push_back(u);
+    }
+    // nobody may decrement before every block is set up
+    barrier();
+
+    while (true) {
+        // open the next bucket with the lowest remaining degree
+        remaining.erase(remove_if(remaining.begin(), remaining.end(), [&](VertexId u) {
+            return core[u] >= 0;
+        }), remaining.end());
+        EdgeId k = LONG_MAX;
+        for (VertexId u : remaining) {
+            k = min(k, degrees[u - g.rank_start]);
+        }
+        k = reduce_all(k, op_fast_min).wait();
+        if (k == LONG_MAX) break;
+        block->k = k;
+
+        frontier.clear();
+        for (VertexId u : remaining) {
+            if (degrees[u - g.rank_start] <= k) {
+                core[u] = k;
+                frontier.push_back(u);
+            }
+        }
+
+        VertexId round = 0;
+        VertexId frontier_size;
+        while ((frontier_size = reduce_all((VertexId) frontier.size(), op_fast_add).wait()) != 0) {
+            round++;
+            bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+            if (DEBUG && rank_me() == 0) cout << "Bucket " << k << " | " << "Round " << round << " | " << "Frontier: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+            if (should_be_sparse_mode) {
+                kcore_sparse(g, block, frontier);
+            } else {
+                sync_frontier_dense(g, frontier, frontier_dense);
+                kcore_dense(g, block, frontier_dense);
+            }
+            // cleared before the next reduction, as faster ranks may start
+            // sending decrements for the next round while we wait in it
+            swap(frontier, frontier_next);
+            frontier_next.clear();
+        }
+    }
+
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(core+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+    barrier();
+    delete_array(frontier_dense_dist);
+    return core;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./kcore <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    VertexId max_core = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        VertexId* core = kcore(g);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        max_core = g.num_nodes > 0 ? *max_element(core, core + g.num_nodes) : 0;
+        delete_array(to_global_ptr(core));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "max_core: " << max_core << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
@@ -0,0 +1,165 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Maximal independent set of a symmetric graph in Luby-style rounds with
+// hashed priorities, as in the OpenMP version. Every rank knows the states
+// of its own vertices and of their neighbors. A round selects the owned
+// winners and removes the owned vertices next to any winner, and after
+// each of the two steps the decisions about boundary vertices, those with
+// a neighbor on another rank, are sent to just the ranks they neighbor.
+
+typedef char State;
+const State undecided = 0;
+const State in_set = 1;
+const State removed = 2;
+
+// the states this rank knows: its own vertices' and its neighbors'
+struct StateBlock {
+    State* states;
+};
+
+// hashed priorities, ties broken by id
+inline bool higher_priority(VertexId u, VertexId v) {
+    unsigned int hu = utils::hash(u), hv = utils::hash(v);
+    return hu > hv || (hu == hv && u > v);
+}
+
+// sends the new states of the decided vertices to the ranks they neighbor
+void send_decisions(Graph& g, dist_object<StateBlock>& block, const vector<VertexId>& decided) {
+    vector<vector<pair<VertexId, State>>> updates(rank_n());
+    vector<VertexId> sent_to(rank_n(), -1);
+    for (VertexId u : decided) {
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            int r = g.vertex_rank(neighbors[j]);
+            if (r == rank_me() || sent_to[r] == u) continue;
+            sent_to[r] = u;
+            updates[r].push_back(make_pair(u, block->states[u]));
+        }
+    }
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (updates[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<StateBlock>& block, view<pair<VertexId, State>> updates) {
+            for (auto& update : updates) block->states[update.first] = update.second;
+        }, block, make_view(updates[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' decisions about our neighbors are in once all are done
+    barrier();
+}
+
+// one round over the owned undecided vertices; returns those that stay
+// undecided
+vector<VertexId> mis_round(Graph& g, dist_object<StateBlock>& block, const vector<VertexId>& frontier) {
+    State* states = block->states;
+    // faster ranks' winners of this round may already be in, which beat
+    // their undecided neighbors just the same
+    vector<VertexId> selected;
+    for (VertexId u : frontier) {
+        bool wins = true;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u) && wins; j++) {
+            VertexId v = neighbors[j];
+            if (v == u) continue;
+            if (states[v] == in_set || (states[v] == undecided && higher_priority(v, u))) wins = false;
+        }
+        if (wins) selected.push_back(u);
+    }
+    for (VertexId u : selected) {
+        states[u] = in_set;
+    }
+    send_decisions(g, block, selected);
+
+    // every winner next to an owned vertex is known by now
+    vector<VertexId> dropped, frontier_next;
+    for (VertexId u : frontier) {
+        if (states[u] != undecided) continue;
+        VertexId* neighbors = g.out_neighbors(u).local();
+        bool drops = false;
+        for (EdgeId j = 0; j < g.out_degree(u) && !drops; j++) {
+            if (states[neighbors[j]] == in_set) drops = true;
+        }
+        if (drops) {
+            dropped.push_back(u);
+        } else {
+            frontier_next.push_back(u);
+        }
+    }
+    for (VertexId u : dropped) {
+        states[u] = removed;
+    }
+    send_decisions(g, block, dropped);
+    return frontier_next;
+}
+
+State* mis(Graph& g) {
+    global_ptr<State> states_dist = new_array<State>(g.num_nodes); State* states = states_dist.local();
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        states[i] = undecided;
+    }
+    dist_object<StateBlock> block(StateBlock{states});
+
+    vector<VertexId> frontier;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        frontier.push_back(u);
+    }
+    // nobody may send decisions before every rank has cleared its states
+    barrier();
+
+    VertexId round = 0;
+    VertexId frontier_size;
+    while ((frontier_size = reduce_all((VertexId) frontier.size(), op_fast_add).wait()) != 0) {
+        round++;
+        if (DEBUG && rank_me() == 0) cout << "Round " << round << " | " << "Undecided: " << frontier_size << endl;
+        frontier = mis_round(g, block, frontier);
+    }
+    // only the owned block and the neighbors' states are set
+    return states;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./mis <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    VertexId mis_size = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        State* states = mis(g);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        mis_size = 0;
+        for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+            if (states[v] == in_set) mis_size++;
+        }
+        mis_size = reduce_all(mis_size, op_fast_add).wait();
+        delete_array(to_global_ptr(states));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "mis_size: " << mis_size << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
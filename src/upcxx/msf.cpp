@@ -0,0 +1,233 @@
+#include "graph_weighted.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Minimum spanning forest by Boruvka rounds, as in the OpenMP version. Each
+// rank keeps the out-edges of its vertices, relabeled by component, and
+// finds the lightest of them per component. A component is owned by the
+// owner of its root vertex, which takes the minimum of the ranks'
+// candidates, sent as one rpc per owner. The hooks are then replicated like
+// dist in bfs, so every rank contracts its copy of parent the same way.
+
+struct WeightedEdge {
+    VertexId u;
+    VertexId v;
+    Weight w;
+};
+
+// an edge between two components, with the key packing its weight and id
+struct ComponentEdge {
+    VertexId u;
+    VertexId v;
+    EdgeId key;
+};
+
+// the lightest edge a rank has for component comp, by its original
+// endpoints
+struct Candidate {
+    VertexId comp;
+    EdgeId key;
+    VertexId u;
+    VertexId v;
+};
+
+// the owned block of components, the target of the candidates
+struct MinBlock {
+    vector<Candidate> best;
+    VertexId start;
+
+    void offer(const Candidate& c) {
+        Candidate& b = best[c.comp - start];
+        if (c.key < b.key) b = c;
+    }
+};
+
+void sync_blocks(Graph& g, VertexId* values) {
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(values+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+    barrier();
+}
+
+// full path compression, afterwards parent[u] is u's root
+void compress(Graph& g, VertexId* parent) {
+    for (VertexId u = 0; u < g.num_nodes; u++) {
+        while (parent[u] != parent[parent[u]]) {
+            parent[u] = parent[parent[u]];
+        }
+    }
+}
+
+// sends the lightest local edge of every component to its owner. The
+// candidates carry the original endpoints of the edge, which the owner
+// needs to tell which side of it its component is on
+void min_edges(Graph& g, dist_object<MinBlock>& block, const vector<ComponentEdge>& working, const vector<WeightedEdge>& edges, EdgeId id_start, EdgeId id_mask, vector<Candidate>& local_best, vector<VertexId>& touched) {
+    for (const ComponentEdge& e : working) {
+        EdgeId id = (e.key & id_mask) - id_start;
+        for (VertexId c : {e.u, e.v}) {
+            if (e.key < local_best[c].key) {
+                if (local_best[c].key == LONG_MAX) touched.push_back(c);
+                local_best[c] = {c, e.key, edges[id].u, edges[id].v};
+            }
+        }
+    }
+
+    vector<vector<Candidate>> candidates(rank_n());
+    for (VertexId c : touched) {
+        candidates[g.vertex_rank(c)].push_back(local_best[c]);
+        local_best[c].key = LONG_MAX;
+    }
+    touched.clear();
+
+    vector<future<>> acks;
+    for (int r = 0; r < rank_n(); r++) {
+        if (candidates[r].empty()) continue;
+        acks.push_back(rpc(r, [](dist_object<MinBlock>& block, view<Candidate> candidates) {
+            for (const Candidate& c : candidates) block->offer(c);
+        }, block, make_view(candidates[r])));
+    }
+    for (auto& ack : acks) ack.wait();
+    // the other ranks' candidates for our components are in once all are done
+    barrier();
+}
+
+vector<WeightedEdge> msf(Graph& g) {
+    // global ids of the out-edges follow the order of the ranks' blocks
+    EdgeId id_start = 0;
+    for (int r = 0; r < rank_n(); r++) {
+        EdgeId count = broadcast(g.num_out_edges_local, r).wait();
+        if (r < rank_me()) id_start += count;
+    }
+
+    vector<WeightedEdge> edges;
+    Weight min_weight = LONG_MAX, max_weight = LONG_MIN;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        VertexId* neighbors = g.out_neighbors(u).local();
+        Weight* weights = g.out_weights_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            edges.push_back({u, neighbors[j], weights[j]});
+            min_weight = min(min_weight, weights[j]);
+            max_weight = max(max_weight, weights[j]);
+        }
+    }
+    min_weight = reduce_all(min_weight, op_fast_min).wait();
+    max_weight = reduce_all(max_weight, op_fast_max).wait();
+
+    // the weight, shifted to start at 0, goes above the id bits
+    int id_bits = utils::log2Up(g.num_edges + 1);
+    EdgeId id_mask = (1L << id_bits) - 1;
+    if (g.num_edges > 0 && (max_weight - min_weight) >= (LONG_MAX >> id_bits)) {
+        if (rank_me() == 0) cout << "Edge weights span too wide a range to pack with edge ids" << endl;
+        abort();
+    }
+
+    vector<ComponentEdge> working;
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (edges[i].u == edges[i].v) continue;
+        working.push_back({edges[i].u, edges[i].v, ((edges[i].w - min_weight) << id_bits) | (EdgeId) (id_start + i)});
+    }
+
+    global_ptr<VertexId> parent_dist = new_array<VertexId>(g.num_nodes); VertexId* parent = parent_dist.local();
+    global_ptr<VertexId> hooks_dist = new_array<VertexId>(g.num_nodes); VertexId* hooks = hooks_dist.local();
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        parent[i] = i;
+    }
+    vector<Candidate> local_best(g.num_nodes, Candidate{-1, LONG_MAX, -1, -1});
+    vector<VertexId> touched;
+    dist_object<MinBlock> block(MinBlock{vector<Candidate>(g.num_nodes_local), g.rank_start});
+    vector<WeightedEdge> forest;
+
+    VertexId round = 0;
+    while (reduce_all((EdgeId) working.size(), op_fast_add).wait() != 0) {
+        round++;
+        for (Candidate& b : block->best) {
+            b.key = LONG_MAX;
+        }
+        // nobody may offer before every block is reset
+        barrier();
+
+        min_edges(g, block, working, edges, id_start, id_mask, local_best, touched);
+
+        // owned components hook onto the one across their lightest edge
+        for (VertexId c = g.rank_start; c < g.rank_end; c++) {
+            const Candidate& b = block->best[c - g.rank_start];
+            hooks[c] = b.key == LONG_MAX ? -1 : parent[b.u] == c ? parent[b.v] : parent[b.u];
+        }
+        sync_blocks(g, hooks);
+
+        // of two components picking the same edge, the smaller one stays a
+        // root and the owner of the other one adds the edge. The hooks are
+        // replicated, so every rank updates its parent the same way
+        EdgeId added = 0;
+        for (VertexId c = 0; c < g.num_nodes; c++) {
+            if (hooks[c] < 0) continue;
+            if (hooks[hooks[c]] == c && c < hooks[c]) continue;
+            parent[c] = hooks[c];
+            if (g.rank_start <= c && c < g.rank_end) {
+                const Candidate& b = block->best[c - g.rank_start];
+                forest.push_back({b.u, b.v, (b.key >> id_bits) + min_weight});
+            }
+            added++;
+        }
+        compress(g, parent);
+
+        // edges now inside a component are dropped
+        vector<ComponentEdge> working_next;
+        for (const ComponentEdge& e : working) {
+            VertexId u = parent[e.u], v = parent[e.v];
+            if (u != v) working_next.push_back({u, v, e.key});
+        }
+        swap(working, working_next);
+        if (DEBUG && rank_me() == 0) cout << "Round " << round << " | " << "Added: " << added << endl;
+    }
+
+    delete_array(parent_dist); delete_array(hooks_dist);
+    return forest;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./msf <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    EdgeId forest_edges = 0;
+    Weight forest_weight = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        // every rank holds the forest edges its components added
+        vector<WeightedEdge> forest = msf(g);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        forest_weight = 0;
+        for (const WeightedEdge& e : forest) {
+            forest_weight += e.w;
+        }
+        forest_edges = reduce_all((EdgeId) forest.size(), op_fast_add).wait();
+        forest_weight = reduce_all(forest_weight, op_fast_add).wait();
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "msf_edges: " << forest_edges << std::endl;
+        std::cout << "msf_weight: " << forest_weight << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
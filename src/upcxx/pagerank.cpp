@@ -5,20 +5,144 @@
 #include <climits>
 #include <stdlib.h> 
 #include <time.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
 #include "sequence.hpp"
 
 using namespace upcxx;
 
 const double damp = 0.85;
 
-void sync_round_dense(Graph& g, double* scores_next) {  
+// PR_MODE=tolerance iterates until the L1 change of the scores drops below
+// PR_EPSILON. PR_MODE=delta only keeps vertices whose pending change exceeds
+// PR_DELTA_THRESHOLD of their score active and pushes just those changes.
+// Both give up after PR_MAX_ITERS rounds; otherwise a fixed 10 rounds are run
+const char* PR_MODE = std::getenv("PR_MODE");
+const double pr_epsilon = env_double("PR_EPSILON", 1e-4);
+const double pr_delta_threshold = env_double("PR_DELTA_THRESHOLD", 0.01);
+const int pr_max_iters = env_double("PR_MAX_ITERS", 100);
+
+// PR_KERNEL=blocking runs the local part of the dense rounds with
+// propagation blocking; PR_BLOCK_SIZE overrides the destinations per bin.
+// PR_KERNEL=mixed keeps and exchanges the contributions as floats
+const char* PR_KERNEL = std::getenv("PR_KERNEL");
+const VertexId pr_block_size = env_double("PR_BLOCK_SIZE", 0);
+
+// the frontier is pushed from while it is under this fraction of the vertices
+const int threshold_fraction_denom = 20;
+
+template <typename T>
+void sync_round_dense(Graph& g, T* scores_next) {  
     for (VertexId i = 0; i < rank_n(); i++) {
         broadcast(scores_next+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
     }
     barrier();
 }
 
-double pagerank_dense(Graph& g, global_ptr<double> scores_dist, global_ptr<double> scores_next_dist, global_ptr<double> errors_dist, global_ptr<double> outgoing_contrib_dist, VertexId level) {
+// Mixed precision as in the OpenMP version. The contributions are the only
+// array every rank reads in full, so they are broadcast as floats, and the
+// scores stay with their owners until the last round.
+
+// only the owned scores are read and written
+double pagerank_mixed(Graph& g, double* scores, double* scores_next, float* outgoing_contrib) {
+    double base_score = (1.0 - damp) / g.num_nodes;
+
+    for (VertexId n = g.rank_start; n < g.rank_end; n++)
+        outgoing_contrib[n] = g.out_degree(n) > 0 ? scores[n] / g.out_degree(n) : 0;
+    barrier();
+    sync_round_dense(g, outgoing_contrib);
+
+    double delta = 0;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        double sum = utils::gather_sum(g.in_neighbors(u).local(), g.in_degree(u), outgoing_contrib);
+        scores_next[u] = base_score + damp * sum;
+        delta += fabs(scores_next[u] - scores[u]);
+    }
+
+    return reduce_all(delta, op_fast_add).wait();
+}
+
+// Propagation blocking as in the OpenMP version, over the in-edges of the
+// owned vertices: they are laid out once in source order, so a round reads
+// the replicated contributions in order and writes them to the bin of their
+// destination's block, and each bin is then summed into its block alone.
+struct PropagationBins {
+    VertexId block_size;
+    VertexId num_bins;
+    // source and destination bin of every owned in-edge, by source
+    vector<VertexId> sources;
+    vector<VertexId> edge_bins;
+    // bin b holds dests and values [offsets[b], offsets[b+1])
+    vector<EdgeId> offsets;
+    vector<VertexId> dests;
+    vector<double> values;
+};
+
+// destinations per bin: by default as many scores as fit in half of the L2
+// cache, leaving room for the streamed bins
+VertexId choose_block_size() {
+    if (pr_block_size >= 1) return pr_block_size;
+    long cache_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (cache_size <= 0) cache_size = 256 * 1024;
+    return max(1L, cache_size / 2 / (long) sizeof(double));
+}
+
+void make_bins(Graph& g, PropagationBins& bins) {
+    bins.block_size = choose_block_size();
+    bins.num_bins = (g.num_nodes_local + bins.block_size - 1) / bins.block_size;
+
+    vector<pair<VertexId, VertexId>> edges;
+    edges.reserve(g.num_in_edges_local);
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        VertexId* neighbors = g.in_neighbors(v).local();
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            edges.push_back(make_pair(neighbors[j], v));
+        }
+    }
+    sort(edges.begin(), edges.end());
+
+    bins.sources.resize(edges.size());
+    bins.edge_bins.resize(edges.size());
+    bins.offsets.assign(bins.num_bins + 1, 0);
+    for (size_t i = 0; i < edges.size(); i++) {
+        bins.sources[i] = edges[i].first;
+        bins.edge_bins[i] = (edges[i].second - g.rank_start) / bins.block_size;
+        bins.offsets[bins.edge_bins[i] + 1]++;
+    }
+    for (VertexId b = 0; b < bins.num_bins; b++) {
+        bins.offsets[b + 1] += bins.offsets[b];
+    }
+
+    bins.dests.resize(edges.size());
+    bins.values.resize(edges.size());
+    vector<EdgeId> cursors(bins.offsets.begin(), bins.offsets.end() - 1);
+    for (size_t i = 0; i < edges.size(); i++) {
+        bins.dests[cursors[bins.edge_bins[i]]++] = edges[i].second;
+    }
+}
+
+// sums the contributions into scores_next of the owned vertices, the same
+// as the pull loop of pagerank_dense
+void accumulate_blocked(Graph& g, PropagationBins& bins, double* scores_next, const double* outgoing_contrib) {
+    vector<EdgeId> cursors(bins.offsets.begin(), bins.offsets.end() - 1);
+    for (size_t i = 0; i < bins.sources.size(); i++) {
+        bins.values[cursors[bins.edge_bins[i]]++] = outgoing_contrib[bins.sources[i]];
+    }
+
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        scores_next[u] = 0;
+    }
+    for (VertexId b = 0; b < bins.num_bins; b++) {
+        for (EdgeId i = bins.offsets[b]; i < bins.offsets[b + 1]; i++) {
+            scores_next[bins.dests[i]] += bins.values[i];
+        }
+    }
+}
+
+// bins is only used, and then instead of the pull loop, when non-null
+double pagerank_dense(Graph& g, global_ptr<double> scores_dist, global_ptr<double> scores_next_dist, global_ptr<double> errors_dist, global_ptr<double> outgoing_contrib_dist, VertexId level, PropagationBins* bins = nullptr) {
     double base_score = (1.0 - damp) / g.num_nodes;
 
     double* scores = scores_dist.local();
@@ -26,32 +150,47 @@ double pagerank_dense(Graph& g, global_ptr<double> scores_dist, global_ptr<doubl
     double* errors = errors_dist.local();
     double* outgoing_contrib = outgoing_contrib_dist.local();
 
+    // vertices without out-edges have nothing to pass on
     for (VertexId n = g.rank_start; n < g.rank_end; n++)
-        outgoing_contrib[n] = scores[n] / g.out_degree(n);
+        outgoing_contrib[n] = g.out_degree(n) > 0 ? scores[n] / g.out_degree(n) : 0;
     barrier();
     sync_round_dense(g, outgoing_contrib);
 
-    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
-        double sum = 0;
-        VertexId* neighbors = g.in_neighbors(u).local(); 
+    if (bins != nullptr) {
+        accumulate_blocked(g, *bins, scores_next, outgoing_contrib);
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            scores_next[u] = base_score + damp * scores_next[u];
+            errors[u] = fabs(scores_next[u] - scores[u]);
+        }
+    } else {
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            double sum = 0;
+            VertexId* neighbors = g.in_neighbors(u).local(); 
 
-        for (EdgeId j = 0; j < g.in_degree(u); j++) {
-            VertexId v = neighbors[j];
-            sum += outgoing_contrib[v];
+            for (EdgeId j = 0; j < g.in_degree(u); j++) {
+                VertexId v = neighbors[j];
+                sum += outgoing_contrib[v];
+            }
+            scores_next[u] = base_score + damp * sum;
+            errors[u] = fabs(scores_next[u] - scores[u]);
         }
-        scores_next[u] = base_score + damp * sum;
-        errors[u] = fabs(scores_next[u] - scores[u]);
     }
     barrier();
     sync_round_dense(g, scores_next);
 
-    double delta = sequence::sum(errors, g.num_nodes);
+    // errors is only filled in for the owned vertices
+    double delta = 0;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        delta += errors[u];
+    }
 
-    return delta;
+    return reduce_all(delta, op_fast_add).wait();
 }
 
 
-double* pagerank(Graph &g, int num_iters) {
+// runs num_iters rounds, or fewer once the L1 change of a round is below
+// epsilon; iterations is set to the number of rounds run
+double* pagerank(Graph &g, int num_iters, double epsilon, int& iterations) {
     global_ptr<double> scores_dist = new_array<double>(g.num_nodes); double* scores = scores_dist.local();
     global_ptr<double> scores_next_dist = new_array<double>(g.num_nodes); double* scores_next = scores_next_dist.local();
 
@@ -63,8 +202,14 @@ double* pagerank(Graph &g, int num_iters) {
         scores[i] = init_score; // set init score
     }
 
+    bool use_blocking = PR_KERNEL != nullptr && strcmp(PR_KERNEL, "blocking") == 0;
+    PropagationBins bins;
+    if (use_blocking) make_bins(g, bins);
+    bool use_mixed = PR_KERNEL != nullptr && strcmp(PR_KERNEL, "mixed") == 0;
+    global_ptr<float> outgoing_contrib_mixed_dist;
+    if (use_mixed) outgoing_contrib_mixed_dist = new_array<float>(g.num_nodes);
+
     VertexId level = 0;
-    const int threshold_fraction_denom = 20;
 
     while (level < num_iters) {
         level++; 
@@ -72,13 +217,24 @@ double* pagerank(Graph &g, int num_iters) {
         if (DEBUG && rank_me() == 0) cout << "Round " << level << endl;
         auto time_before = chrono::system_clock::now();
 
-        pagerank_dense(g, scores_dist, scores_next_dist, errors_dist, outgoing_contrib_dist, level);
+        double error;
+        if (use_mixed) {
+            error = pagerank_mixed(g, scores, scores_next, outgoing_contrib_mixed_dist.local());
+        } else {
+            error = pagerank_dense(g, scores_dist, scores_next_dist, errors_dist, outgoing_contrib_dist, level, use_blocking ? &bins : nullptr);
+        }
 
         swap(scores_next_dist, scores_dist);
         swap(scores_next, scores);
         auto time_after = chrono::system_clock::now();
         chrono::duration<double> delta = (time_after - time_before);
-        if (DEBUG && rank_me() == 0) cout << "Time: " << delta.count() << endl;
+        if (DEBUG && rank_me() == 0) cout << "Time: " << delta.count() << " | " << "Error: " << error << endl;
+        if (error < epsilon) break;
+    }
+    iterations = level;
+    if (use_mixed) {
+        sync_round_dense(g, scores);
+        delete_array(outgoing_contrib_mixed_dist);
     }
 
     delete_array(scores_next_dist); delete_array(errors_dist); delete_array(outgoing_contrib_dist); 
@@ -86,6 +242,121 @@ double* pagerank(Graph &g, int num_iters) {
     return scores; 
 }
 
+// Delta-PageRank as in the OpenMP version: only active vertices, whose
+// pending residual exceeds the threshold, fold it into their score and push
+// damp times it to their out-neighbors. Residuals are kept by the owners. In
+// sparse rounds every rank pushes into its copy of incoming and the copies
+// are summed with a reduction; dense rounds broadcast the contributions and
+// owners pull them like pagerank_dense does.
+
+inline bool pagerank_delta_active(VertexId v, double* scores, double residual) {
+    return fabs(residual) > pr_delta_threshold * scores[v];
+}
+
+// makes the residuals of the active owned vertices part of their scores;
+// returns what u passes on to each of its out-neighbors
+inline double pagerank_delta_apply(Graph& g, VertexId u, double* scores, vector<double>& residuals) {
+    double& residual = residuals[u - g.rank_start];
+    double contrib = g.out_degree(u) > 0 ? damp * residual / g.out_degree(u) : 0;
+    scores[u] += residual;
+    residual = 0;
+    return contrib;
+}
+
+void pagerank_delta_sparse(Graph& g, double* scores, vector<double>& residuals, double* incoming, const vector<VertexId>& frontier) {
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        incoming[i] = 0;
+    }
+    for (VertexId u : frontier) {
+        double contrib = pagerank_delta_apply(g, u, scores, residuals);
+        VertexId* neighbors = g.out_neighbors(u).local();
+        for (EdgeId j = 0; j < g.out_degree(u); j++) {
+            incoming[neighbors[j]] += contrib;
+        }
+    }
+    reduce_all(incoming, incoming, g.num_nodes, op_fast_add).wait();
+    barrier();
+}
+
+void pagerank_delta_dense(Graph& g, double* scores, vector<double>& residuals, double* incoming, double* outgoing_contrib, const vector<VertexId>& frontier) {
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        outgoing_contrib[u] = 0;
+    }
+    for (VertexId u : frontier) {
+        outgoing_contrib[u] = pagerank_delta_apply(g, u, scores, residuals);
+    }
+    sync_round_dense(g, outgoing_contrib);
+
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        double sum = 0;
+        VertexId* neighbors = g.in_neighbors(v).local();
+        for (EdgeId j = 0; j < g.in_degree(v); j++) {
+            sum += outgoing_contrib[neighbors[j]];
+        }
+        incoming[v] = sum;
+    }
+}
+
+double* pagerank_delta(Graph& g, int num_iters, int& iterations) {
+    global_ptr<double> scores_dist = new_array<double>(g.num_nodes); double* scores = scores_dist.local();
+    global_ptr<double> incoming_dist = new_array<double>(g.num_nodes); double* incoming = incoming_dist.local();
+    global_ptr<double> outgoing_contrib_dist = new_array<double>(g.num_nodes); double* outgoing_contrib = outgoing_contrib_dist.local();
+    vector<double> residuals(g.num_nodes_local);
+
+    double init_score = 1.0 / g.num_nodes;
+    double base_score = (1.0 - damp) / g.num_nodes;
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        scores[i] = init_score;
+    }
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        outgoing_contrib[u] = g.out_degree(u) > 0 ? init_score / g.out_degree(u) : 0;
+    }
+    sync_round_dense(g, outgoing_contrib);
+
+    // the first round is a full one, what it would change the scores by
+    // becomes the starting residual
+    vector<VertexId> frontier;
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        double sum = 0;
+        VertexId* neighbors = g.in_neighbors(u).local();
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            sum += outgoing_contrib[neighbors[j]];
+        }
+        residuals[u - g.rank_start] = base_score + damp * sum - scores[u];
+        if (pagerank_delta_active(u, scores, residuals[u - g.rank_start])) frontier.push_back(u);
+    }
+
+    VertexId level = 1;
+    VertexId frontier_size;
+    while ((frontier_size = reduce_all((VertexId) frontier.size(), op_fast_add).wait()) != 0 && level < num_iters) {
+        level++;
+        bool should_be_sparse_mode = frontier_size < (g.num_nodes / threshold_fraction_denom);
+        if (DEBUG && rank_me() == 0) cout << "Round " << level << " | " << "Active: " << frontier_size << " | Sparse? " << should_be_sparse_mode << endl;
+
+        if (should_be_sparse_mode) {
+            pagerank_delta_sparse(g, scores, residuals, incoming, frontier);
+        } else {
+            pagerank_delta_dense(g, scores, residuals, incoming, outgoing_contrib, frontier);
+        }
+
+        frontier.clear();
+        for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+            residuals[v - g.rank_start] += incoming[v];
+            if (pagerank_delta_active(v, scores, residuals[v - g.rank_start])) frontier.push_back(v);
+        }
+    }
+    iterations = level;
+
+    // fold in what is still pending and share the owned scores
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        scores[v] += residuals[v - g.rank_start];
+    }
+    sync_round_dense(g, scores);
+
+    delete_array(incoming_dist); delete_array(outgoing_contrib_dist);
+    return scores;
+}
+
 int main(int argc, char *argv[]) {
     if (argc != 3) {
         cout << "Usage: ./pagerank <path_to_graph> <num_iters>" << endl;
@@ -99,22 +370,37 @@ int main(int argc, char *argv[]) {
     Graph g(argv[1]);
     int num_iters = atoi(argv[2]);
 
+    bool use_tolerance = PR_MODE != nullptr && strcmp(PR_MODE, "tolerance") == 0;
+    bool use_delta = PR_MODE != nullptr && strcmp(PR_MODE, "delta") == 0;
+
     barrier(); 
-    float current_time = 0.0;
+    double current_time = 0.0;
+    double current_iterations = 0.0;
     for (int i = 0; i < num_iters; i++) {
+        int iterations;
         auto time_before = std::chrono::system_clock::now();
-        double* scores = pagerank(g, max_iters);
+        double* scores;
+        if (use_delta) {
+            scores = pagerank_delta(g, pr_max_iters, iterations);
+        } else if (use_tolerance) {
+            scores = pagerank(g, pr_max_iters, pr_epsilon, iterations);
+        } else {
+            scores = pagerank(g, max_iters, 0, iterations);
+        }
         auto time_after = std::chrono::system_clock::now();
         std::chrono::duration<double> delta_time = time_after - time_before;
         current_time += delta_time.count();
+        current_iterations += iterations;
         /* if (rank_me() == 0) {
             for (VertexId i = 0; i < g.num_nodes; i++)
                 cout << scores[i] << endl;
         } */
+        delete_array(to_global_ptr(scores));
         barrier();
     }
     
     if (rank_me() == 0) {
+        if (use_delta || use_tolerance) std::cout << "iterations: " << current_iterations / num_iters << std::endl;
         std::cout << current_time / num_iters << std::endl;
         /* if (!verify(g, root, dist)) {
             std::cerr << "Verification not correct" << endl;
@@ -0,0 +1,294 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdlib.h>
+#include "frontier.hpp"
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// Strongly connected components by trimming, forward-backward search from a
+// pivot and coloring, as in the OpenMP version; every SCC is labeled with
+// its smallest vertex id. labels, colors and the search marks are replicated
+// like dist in bfs: in sparse rounds every rank writes into its copy and
+// the copies are merged with a reduction, in dense rounds owners pull for
+// their own vertices and broadcast their block.
+
+// trimming stops after this many rounds, coloring handles longer chains
+const int trim_max_rounds = 3;
+
+void sync_blocks(Graph& g, VertexId* values) {
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(values+g.rank_start_node(i), g.rank_num_nodes(i), i).wait();
+    }
+    barrier();
+}
+
+// singletons: live vertices without a live in- or out-neighbor
+void trim(Graph& g, VertexId* labels) {
+    for (int round = 0; round < trim_max_rounds; round++) {
+        vector<VertexId> trimmed;
+        for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+            if (labels[v] >= 0) continue;
+            bool has_in = false, has_out = false;
+            VertexId* neighbors = g.in_neighbors(v).local();
+            for (EdgeId j = 0; j < g.in_degree(v) && !has_in; j++) {
+                if (labels[neighbors[j]] < 0 && neighbors[j] != v) has_in = true;
+            }
+            neighbors = g.out_neighbors(v).local();
+            for (EdgeId j = 0; j < g.out_degree(v) && !has_out; j++) {
+                if (labels[neighbors[j]] < 0 && neighbors[j] != v) has_out = true;
+            }
+            if (!has_in || !has_out) trimmed.push_back(v);
+        }
+        VertexId num_trimmed = reduce_all((VertexId) trimmed.size(), op_fast_add).wait();
+        if (DEBUG && rank_me() == 0) cout << "Trim round " << round << " | " << "Trimmed: " << num_trimmed << endl;
+        if (num_trimmed == 0) break;
+
+        for (VertexId v : trimmed) {
+            labels[v] = v;
+        }
+        sync_blocks(g, labels);
+    }
+}
+
+// the edges v would scan in a search forward or backward
+inline EdgeId search_degree(Graph& g, bool forward, VertexId v) {
+    return forward ? g.out_degree(v) : g.in_degree(v);
+}
+
+// the edges the owned vertices of frontier would scan, summed across ranks
+EdgeId search_edges(Graph& g, bool forward, const vector<VertexId>& frontier) {
+    EdgeId edges = 0;
+    for (VertexId v : frontier) {
+        edges += search_degree(g, forward, v);
+    }
+    return reduce_all(edges, op_fast_add).wait();
+}
+
+// marks in visited, by round, the live vertices reachable from root,
+// forward along out-edges or backward along in-edges; -1 is unreached.
+// Rounds go top-down or bottom-up by the switch of bfs
+void reach(Graph& g, VertexId root, bool forward, const VertexId* labels, VertexId* visited) {
+    for (VertexId i = 0; i < g.num_nodes; i++) {
+        visited[i] = -1;
+    }
+    visited[root] = 0;
+    vector<VertexId> frontier;
+    if (g.rank_start <= root && root < g.rank_end) frontier.push_back(root);
+    VertexId frontier_size = 1;
+
+    // m_u counts the edges of the live vertices only
+    EdgeId unexplored_edges = 0;
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        if (labels[v] < 0) unexplored_edges += search_degree(g, forward, v);
+    }
+    unexplored_edges = reduce_all(unexplored_edges, op_fast_add).wait();
+    EdgeId frontier_edges = search_edges(g, forward, frontier);
+    unexplored_edges -= frontier_edges;
+    VertexId prev_frontier_size = 0;
+    bool is_sparse_mode = true;
+
+    for (VertexId round = 0; frontier_size != 0; round++) {
+        is_sparse_mode = next_sparse_mode(is_sparse_mode, g.num_nodes, frontier_size, prev_frontier_size, frontier_edges, unexplored_edges);
+        prev_frontier_size = frontier_size;
+        if (is_sparse_mode) {
+            // top-down: push from the owned part of the frontier
+            for (VertexId u : frontier) {
+                VertexId* neighbors = forward ? g.out_neighbors(u).local() : g.in_neighbors(u).local();
+                EdgeId degree = search_degree(g, forward, u);
+                for (EdgeId j = 0; j < degree; j++) {
+                    VertexId v = neighbors[j];
+                    if (labels[v] < 0 && visited[v] < 0) visited[v] = round + 1;
+                }
+            }
+            reduce_all(visited, visited, g.num_nodes, op_fast_max).wait();
+            barrier();
+        } else {
+            // bottom-up: owned vertices look for a frontier neighbor
+            for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+                if (labels[v] >= 0 || visited[v] >= 0) continue;
+                VertexId* neighbors = forward ? g.in_neighbors(v).local() : g.out_neighbors(v).local();
+                EdgeId degree = forward ? g.in_degree(v) : g.out_degree(v);
+                for (EdgeId j = 0; j < degree; j++) {
+                    if (visited[neighbors[j]] == round) {
+                        visited[v] = round + 1;
+                        break;
+                    }
+                }
+            }
+            sync_blocks(g, visited);
+        }
+
+        frontier.clear();
+        for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+            if (visited[v] == round + 1) frontier.push_back(v);
+        }
+        frontier_size = reduce_all((VertexId) frontier.size(), op_fast_add).wait();
+        frontier_edges = search_edges(g, forward, frontier);
+        unexplored_edges -= frontier_edges;
+    }
+}
+
+// peels off the SCC of the live vertex with the largest in-degree times
+// out-degree, which in most graphs sits in the giant SCC
+void forward_backward(Graph& g, VertexId* labels) {
+    EdgeId pivot_score = -1;
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        if (labels[v] < 0) pivot_score = max(pivot_score, g.in_degree(v) * g.out_degree(v));
+    }
+    pivot_score = reduce_all(pivot_score, op_fast_max).wait();
+    if (pivot_score < 0) return;
+    VertexId pivot = LONG_MAX;
+    for (VertexId v = g.rank_start; v < g.rank_end && pivot == LONG_MAX; v++) {
+        if (labels[v] < 0 && g.in_degree(v) * g.out_degree(v) == pivot_score) pivot = v;
+    }
+    pivot = reduce_all(pivot, op_fast_min).wait();
+
+    global_ptr<VertexId> forward_dist = new_array<VertexId>(g.num_nodes); VertexId* forward = forward_dist.local();
+    global_ptr<VertexId> backward_dist = new_array<VertexId>(g.num_nodes); VertexId* backward = backward_dist.local();
+    reach(g, pivot, true, labels, forward);
+    reach(g, pivot, false, labels, backward);
+
+    // the search marks are replicated, so every rank labels the whole SCC
+    VertexId label = LONG_MAX;
+    for (VertexId v = 0; v < g.num_nodes && label == LONG_MAX; v++) {
+        if (forward[v] >= 0 && backward[v] >= 0) label = v;
+    }
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        if (forward[v] >= 0 && backward[v] >= 0) labels[v] = label;
+    }
+    if (DEBUG && rank_me() == 0) cout << "Pivot " << pivot << " | " << "SCC " << label << endl;
+    delete_array(forward_dist); delete_array(backward_dist);
+}
+
+// one round of coloring; every live vertex ends up in an SCC or keeps
+// being live for the next round. Returns the number of SCCs found
+VertexId color_round(Graph& g, VertexId* labels, VertexId* colors) {
+    vector<VertexId> frontier;
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        colors[v] = v;
+    }
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        if (labels[v] < 0) frontier.push_back(v);
+    }
+
+    // push the smallest color reaching every vertex along out-edges
+    vector<VertexId> old_colors(g.num_nodes_local);
+    while (reduce_all((VertexId) frontier.size(), op_fast_add).wait() != 0) {
+        copy(colors + g.rank_start, colors + g.rank_end, old_colors.begin());
+        for (VertexId u : frontier) {
+            VertexId* neighbors = g.out_neighbors(u).local();
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                VertexId v = neighbors[j];
+                if (labels[v] < 0) priority_update(&colors[v], colors[u]);
+            }
+        }
+        reduce_all(colors, colors, g.num_nodes, op_fast_min).wait();
+        barrier();
+
+        frontier.clear();
+        for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+            if (colors[v] < old_colors[v - g.rank_start]) frontier.push_back(v);
+        }
+    }
+
+    // no smaller vertex reaches a vertex that kept its own color, so it is
+    // the smallest of its SCC, which is the part of its color that reaches it
+    for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+        if (labels[v] < 0 && colors[v] == v) {
+            labels[v] = v;
+            frontier.push_back(v);
+        }
+    }
+    VertexId num_roots = reduce_all((VertexId) frontier.size(), op_fast_add).wait();
+    sync_blocks(g, labels);
+
+    vector<VertexId> old_labels(g.num_nodes_local);
+    while (reduce_all((VertexId) frontier.size(), op_fast_add).wait() != 0) {
+        copy(labels + g.rank_start, labels + g.rank_end, old_labels.begin());
+        for (VertexId v : frontier) {
+            VertexId* neighbors = g.in_neighbors(v).local();
+            for (EdgeId j = 0; j < g.in_degree(v); j++) {
+                VertexId u = neighbors[j];
+                if (colors[u] == colors[v] && labels[u] < 0) labels[u] = colors[v];
+            }
+        }
+        // a vertex only ever gets the label of its color, so the max keeps
+        // it over the -1 of the other copies
+        reduce_all(labels, labels, g.num_nodes, op_fast_max).wait();
+        barrier();
+
+        frontier.clear();
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            if (labels[u] != old_labels[u - g.rank_start]) frontier.push_back(u);
+        }
+    }
+    return num_roots;
+}
+
+VertexId* scc(Graph& g) {
+    global_ptr<VertexId> labels_dist = new_array<VertexId>(g.num_nodes); VertexId* labels = labels_dist.local();
+    for (VertexId v = 0; v < g.num_nodes; v++) {
+        labels[v] = -1;
+    }
+
+    trim(g, labels);
+    forward_backward(g, labels);
+    trim(g, labels);
+
+    global_ptr<VertexId> colors_dist = new_array<VertexId>(g.num_nodes); VertexId* colors = colors_dist.local();
+    VertexId round = 0;
+    while (true) {
+        VertexId live = 0;
+        for (VertexId v = g.rank_start; v < g.rank_end; v++) {
+            if (labels[v] < 0) live++;
+        }
+        live = reduce_all(live, op_fast_add).wait();
+        if (live == 0) break;
+        VertexId found = color_round(g, labels, colors);
+        if (DEBUG && rank_me() == 0) cout << "Coloring round " << ++round << " | " << "Live: " << live << " | " << "SCCs: " << found << endl;
+    }
+
+    delete_array(colors_dist);
+    return labels;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./scc <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    barrier();
+    VertexId num_sccs = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        VertexId* labels = scc(g);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        num_sccs = 0;
+        for (VertexId v = 0; v < g.num_nodes; v++) {
+            if (labels[v] == v) num_sccs++;
+        }
+        delete_array(to_global_ptr(labels));
+        barrier();
+    }
+
+    if (rank_me() == 0) {
+        std::cout << "sccs: " << num_sccs << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}
@@ -0,0 +1,323 @@
+#include "graph.hpp"
+#include "upcxx/upcxx.hpp"
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdlib.h>
+#include "sequence.hpp"
+
+using namespace upcxx;
+
+// The k largest eigenpairs of the adjacency matrix or of D^-1/2 A D^-1/2
+// of a symmetric graph by LOBPCG, as in the OpenMP version. Every rank
+// keeps all rows of the blocks of vectors but only works on its own. The
+// block a product reads is exchanged as pagerank_dense exchanges its
+// contributions, every rank broadcasting its rows, and the small
+// projected matrices are summed with reduce_all, so every rank solves the
+// same small eigenproblems and takes the same steps.
+const char* SPECTRAL_MATRIX = std::getenv("SPECTRAL_MATRIX");
+
+// number of eigenpairs
+const int spectral_k = env_double("SPECTRAL_K", 4);
+// done once every residual norm is below SPECTRAL_TOL times the largest
+// eigenvalue in magnitude
+const double spectral_tol = env_double("SPECTRAL_TOL", 1e-6);
+const int spectral_max_iters = env_double("SPECTRAL_MAX_ITERS", 500);
+
+// n vectors of the same width, stored row-major
+struct Block {
+    int width;
+    vector<double> values;
+
+    Block(VertexId n = 0, int width = 0) : width(width), values(n * width, 0) {}
+    double* row(VertexId u) { return values.data() + u * width; }
+    const double* row(VertexId u) const { return values.data() + u * width; }
+};
+
+// every rank's rows to every other rank
+void sync_rows(Graph& g, Block& x) {
+    for (VertexId i = 0; i < rank_n(); i++) {
+        broadcast(x.row(g.rank_start_node(i)), g.rank_num_nodes(i) * x.width, i).wait();
+    }
+    barrier();
+}
+
+// the owned rows of Y = M X for M = diag(scale) A diag(scale), A without
+// scaling if scale is nullptr. The sources are scaled before the exchange,
+// as pagerank_dense divides the scores by the degrees
+void spmm(Graph& g, const double* scale, const Block& x, Block& y) {
+    int w = x.width;
+    Block z(g.num_nodes, w);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        for (int c = 0; c < w; c++) z.row(u)[c] = (scale != nullptr ? scale[u] : 1) * x.row(u)[c];
+    }
+    sync_rows(g, z);
+
+    y = Block(g.num_nodes, w);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        double* sum = y.row(u);
+        VertexId* neighbors = g.in_neighbors(u).local();
+        for (EdgeId j = 0; j < g.in_degree(u); j++) {
+            const double* zv = z.row(neighbors[j]);
+            for (int c = 0; c < w; c++) sum[c] += zv[c];
+        }
+        if (scale != nullptr) {
+            for (int c = 0; c < w; c++) sum[c] *= scale[u];
+        }
+    }
+}
+
+// the a.width x b.width matrix a^T b, on every rank
+vector<double> gram(Graph& g, const Block& a, const Block& b) {
+    int wa = a.width, wb = b.width;
+    vector<double> result(wa * wb, 0);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        const double* au = a.row(u);
+        const double* bu = b.row(u);
+        for (int i = 0; i < wa; i++) {
+            for (int j = 0; j < wb; j++) result[i * wb + j] += au[i] * bu[j];
+        }
+    }
+    if (!result.empty()) reduce_all(result.data(), result.data(), wa * wb, op_fast_add).wait();
+    return result;
+}
+
+// the owned rows of a c, for c a a.width x width matrix
+Block combine(Graph& g, const Block& a, const vector<double>& c, int width) {
+    Block result(g.num_nodes, width);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        const double* au = a.row(u);
+        double* ru = result.row(u);
+        for (int i = 0; i < a.width; i++) {
+            for (int j = 0; j < width; j++) ru[j] += au[i] * c[i * width + j];
+        }
+    }
+    return result;
+}
+
+// eigenvalues of the symmetric m x m matrix a in descending order, and
+// the matching eigenvectors as the columns of v, by cyclic Jacobi
+// rotations
+void symmetric_eigen(vector<double> a, int m, vector<double>& eigenvalues, vector<double>& v) {
+    vector<double> rotated(m * m, 0);
+    for (int i = 0; i < m; i++) rotated[i * m + i] = 1;
+
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double off = 0, total = 0;
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) {
+                total += a[i * m + j] * a[i * m + j];
+                if (i != j) off += a[i * m + j] * a[i * m + j];
+            }
+        }
+        if (off <= 1e-30 * total) break;
+
+        for (int p = 0; p < m; p++) {
+            for (int q = p + 1; q < m; q++) {
+                double apq = a[p * m + q];
+                if (apq == 0) continue;
+                // the rotation by t = tan(phi) zeroes a[p][q]
+                double theta = (a[q * m + q] - a[p * m + p]) / (2 * apq);
+                double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                double c = 1 / sqrt(t * t + 1), s = t * c;
+                for (int r = 0; r < m; r++) {
+                    double arp = a[r * m + p], arq = a[r * m + q];
+                    a[r * m + p] = c * arp - s * arq;
+                    a[r * m + q] = s * arp + c * arq;
+                }
+                for (int r = 0; r < m; r++) {
+                    double apr = a[p * m + r], aqr = a[q * m + r];
+                    a[p * m + r] = c * apr - s * aqr;
+                    a[q * m + r] = s * apr + c * aqr;
+                }
+                for (int r = 0; r < m; r++) {
+                    double vrp = rotated[r * m + p], vrq = rotated[r * m + q];
+                    rotated[r * m + p] = c * vrp - s * vrq;
+                    rotated[r * m + q] = s * vrp + c * vrq;
+                }
+            }
+        }
+    }
+
+    vector<int> order(m);
+    for (int i = 0; i < m; i++) order[i] = i;
+    sort(order.begin(), order.end(), [&](int i, int j) { return a[i * m + i] > a[j * m + j]; });
+    eigenvalues.resize(m);
+    v.resize(m * m);
+    for (int j = 0; j < m; j++) {
+        eigenvalues[j] = a[order[j] * m + order[j]];
+        for (int i = 0; i < m; i++) v[i * m + j] = rotated[i * m + order[j]];
+    }
+}
+
+// an orthonormal basis of the span of w, by the eigenvectors of its
+// column-scaled Gram matrix, dropping numerically dependent directions
+Block svqb(Graph& g, const Block& w) {
+    int m = w.width;
+    vector<double> s = gram(g, w, w);
+    vector<double> norms(m);
+    for (int i = 0; i < m; i++) norms[i] = s[i * m + i] > 0 ? 1 / sqrt(s[i * m + i]) : 0;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) s[i * m + j] *= norms[i] * norms[j];
+    }
+
+    vector<double> eigenvalues, v;
+    symmetric_eigen(s, m, eigenvalues, v);
+    int width = 0;
+    while (width < m && eigenvalues[width] > 1e-10 * max(eigenvalues[0], 1e-300)) width++;
+    vector<double> c(m * width);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < width; j++) c[i * width + j] = norms[i] * v[i * m + j] / sqrt(eigenvalues[j]);
+    }
+    return combine(g, w, c, width);
+}
+
+// w less its projection on the orthonormal x
+void project_out(Graph& g, const Block& x, Block& w) {
+    vector<double> c = gram(g, x, w);
+    Block p = combine(g, x, c, w.width);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        for (int i = 0; i < w.width; i++) w.row(u)[i] -= p.row(u)[i];
+    }
+}
+
+// the owned rows of a and b side by side
+Block concat(Graph& g, const Block& a, const Block& b) {
+    Block result(g.num_nodes, a.width + b.width);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        copy(a.row(u), a.row(u) + a.width, result.row(u));
+        copy(b.row(u), b.row(u) + b.width, result.row(u) + a.width);
+    }
+    return result;
+}
+
+// the k largest eigenvalues of M, with the owned rows of the eigenvectors
+// in x. Returns the number of iterations
+int lobpcg(Graph& g, const double* scale, int k, Block& x, vector<double>& eigenvalues) {
+    // the same random start as the OpenMP version
+    x = Block(g.num_nodes, k);
+    for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+        for (int c = 0; c < k; c++) x.row(u)[c] = utils::hash(u * k + c) / (double) UINT_MAX - 0.5;
+    }
+    x = svqb(g, x);
+    k = x.width;
+    Block ax, p;
+    spmm(g, scale, x, ax);
+
+    vector<double> ritz_values, c;
+    symmetric_eigen(gram(g, x, ax), k, ritz_values, c);
+    x = combine(g, x, c, k);
+    ax = combine(g, ax, c, k);
+    eigenvalues.assign(ritz_values.begin(), ritz_values.begin() + k);
+
+    int iter = 0;
+    while (iter < spectral_max_iters) {
+        iter++;
+        Block r = ax;
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            for (int i = 0; i < k; i++) r.row(u)[i] -= eigenvalues[i] * x.row(u)[i];
+        }
+        vector<double> rr = gram(g, r, r);
+        double largest = 0, worst = 0;
+        for (int i = 0; i < k; i++) {
+            largest = max(largest, fabs(eigenvalues[i]));
+            worst = max(worst, sqrt(max(rr[i * k + i], 0.0)));
+        }
+        if (DEBUG && rank_me() == 0) cout << "Iteration " << iter << " | " << "Residual: " << worst << endl;
+        if (worst <= spectral_tol * max(largest, 1e-300)) break;
+
+        Block w = p.width > 0 ? concat(g, r, p) : r;
+        for (int pass = 0; pass < 2 && w.width > 0; pass++) {
+            project_out(g, x, w);
+            w = svqb(g, w);
+        }
+        if (w.width == 0) break;
+        Block aw;
+        spmm(g, scale, w, aw);
+
+        Block s = concat(g, x, w), as = concat(g, ax, aw);
+        int m = s.width;
+        vector<double> h = gram(g, s, as);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < i; j++) h[i * m + j] = h[j * m + i] = (h[i * m + j] + h[j * m + i]) / 2;
+        }
+        symmetric_eigen(h, m, ritz_values, c);
+        vector<double> c_k(m * k), c_w(w.width * k);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < k; j++) {
+                c_k[i * k + j] = c[i * m + j];
+                if (i >= k) c_w[(i - k) * k + j] = c[i * m + j];
+            }
+        }
+        x = combine(g, s, c_k, k);
+        ax = combine(g, as, c_k, k);
+        p = combine(g, w, c_w, k);
+        eigenvalues.assign(ritz_values.begin(), ritz_values.begin() + k);
+    }
+    return iter;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cout << "Usage: ./spectral <path_to_graph> <num_iters>" << endl;
+        exit(-1);
+    }
+
+    init();
+
+    Graph g(argv[1]);
+    int num_iters = atoi(argv[2]);
+
+    bool use_adjacency = SPECTRAL_MATRIX != nullptr && strcmp(SPECTRAL_MATRIX, "adjacency") == 0;
+    int k = min((VertexId) spectral_k, g.num_nodes);
+    // D^-1/2 of the owned vertices, with isolated vertices left out of N
+    vector<double> scale;
+    if (!use_adjacency) {
+        scale.resize(g.num_nodes, 0);
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            scale[u] = g.out_degree(u) > 0 ? 1 / sqrt((double) g.out_degree(u)) : 0;
+        }
+    }
+
+    barrier();
+    Block x;
+    vector<double> eigenvalues;
+    int iters = 0;
+    double current_time = 0.0;
+    for (int i = 0; i < num_iters; i++) {
+        auto time_before = std::chrono::system_clock::now();
+        iters = lobpcg(g, use_adjacency ? nullptr : scale.data(), k, x, eigenvalues);
+        auto time_after = std::chrono::system_clock::now();
+        std::chrono::duration<double> delta_time = time_after - time_before;
+        current_time += delta_time.count();
+        barrier();
+    }
+
+    EdgeId cut = 0;
+    if (!use_adjacency && x.width >= 2) {
+        // the sign of the Fiedler vector splits the graph in two
+        sync_rows(g, x);
+        for (VertexId u = g.rank_start; u < g.rank_end; u++) {
+            VertexId* neighbors = g.out_neighbors(u).local();
+            for (EdgeId j = 0; j < g.out_degree(u); j++) {
+                if ((x.row(u)[1] < 0) != (x.row(neighbors[j])[1] < 0)) cut++;
+            }
+        }
+        cut = reduce_all(cut, op_fast_add).wait();
+    }
+
+    if (rank_me() == 0) {
+        // the normalized Laplacian's eigenvalues are one less those of N
+        std::cout << "eigenvalues:";
+        for (double lambda : eigenvalues) std::cout << " " << (use_adjacency ? lambda : 1 - lambda);
+        std::cout << std::endl;
+        std::cout << "iterations: " << iters << std::endl;
+        if (!use_adjacency && x.width >= 2) std::cout << "fiedler_cut: " << cut / 2 << std::endl;
+        std::cout << current_time / num_iters << std::endl;
+    }
+    barrier();
+    finalize();
+}